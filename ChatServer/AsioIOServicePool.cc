@@ -1,26 +1,171 @@
 #include "AsioIOServicePool.hpp"
 
-AsioIOServicePool::AsioIOServicePool(std::size_t size)
-    : ioservices_(size), works_(size), next_ioservice_(0) {
+#include <pthread.h>
+#include <sched.h>
+
+#include <sstream>
+
+#include "ConfigManager.hpp"
+#include "Metrics.hpp"
+#include "TimingWheel.hpp"
+
+namespace {
+const int kProbeIntervalMs = 1000;
+const int64_t kDefaultLagLimitMs = 50;
+// 滞后的io_context只在全部滞后时才会被选中
+const int64_t kLagPenalty = int64_t(1) << 40;
+
+std::size_t ThreadCount() {
+  auto value = ConfigManager::GetInstance()["IOPool"]["ThreadCount"];
+  std::size_t count = value.empty() ? std::thread::hardware_concurrency()
+                                    : std::stoul(value);
+  return std::max<std::size_t>(count, 1);
+}
+
+// 解析形如 "2,3,6-9" 的cpu列表
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    auto dash = item.find('-');
+    if (dash == std::string::npos) {
+      cpus.push_back(std::stoi(item));
+      continue;
+    }
+    int first = std::stoi(item.substr(0, dash));
+    int last = std::stoi(item.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+}  // namespace
+
+AsioIOServicePool::AsioIOServicePool()
+    : ioservices_(ThreadCount()), works_(ioservices_.size()),
+      next_ioservice_(0) {
+  auto& cfg = ConfigManager::GetInstance();
+  std::size_t size = ioservices_.size();
   // 把ioservice绑定到ioservice防止ioservice退出
   for (std::size_t i = 0; i < size; ++i) {
     works_[i] = std::unique_ptr<Work>(new Work(ioservices_[i]));
   }
 
+  // 每个ioservice一个时间轮回收空闲session, 超时为0时不回收
+  auto idle_timeout = cfg["Session"]["IdleTimeoutSec"];
+  uint64_t timeout_sec = idle_timeout.empty() ? kDefaultIdleTimeoutSec
+                                              : std::stoull(idle_timeout);
+  uint64_t timeout_ticks = timeout_sec * 1000 / kWheelTickMs;
+  for (std::size_t i = 0; i < size; ++i) {
+    wheels_.push_back(std::make_unique<TimingWheel>(
+        ioservices_[i], kWheelTickMs, timeout_ticks));
+    wheels_[i]->Start();
+  }
+
+  auto lag_limit = cfg["IOPool"]["LagLimitMs"];
+  lag_limit_us_ =
+      (lag_limit.empty() ? kDefaultLagLimitMs : std::stoll(lag_limit)) * 1000;
+  auto metrics = Metrics::GetInstance();
+  for (std::size_t i = 0; i < size; ++i) {
+    auto prefix = "io.ctx" + std::to_string(i);
+    auto stats = std::make_unique<ContextStats>(ioservices_[i]);
+    stats->sessions_ = &metrics->Counter(prefix + ".sessions");
+    stats->lag_us_ = &metrics->Counter(prefix + ".lag_us");
+    stats_.push_back(std::move(stats));
+    Probe(i);
+  }
+
+  cpus_ = ParseCpuList(cfg["IOPool"]["CpuList"]);
   // 遍历多个ioservice，创建多个线程，每个线程内部启动ioservice
-  for (std::size_t i = 0; i < ioservices_.size(); ++i) {
-    threads_.emplace_back([this, i]() { ioservices_[i].run(); });
+  for (std::size_t i = 0; i < size; ++i) {
+    threads_.emplace_back([this, i]() {
+      PinThread(i);
+      // 负载由session数和探测定时器的滞后反映, 不逐个统计handler
+      ioservices_[i].run();
+    });
   }
 }
 
 AsioIOServicePool::~AsioIOServicePool() {}
 
 boost::asio::io_context& AsioIOServicePool::GetIOService() {
-  auto& service = ioservices_[next_ioservice_++];
-  if (next_ioservice_ == ioservices_.size()) {
-    next_ioservice_ = 0;
+  // SO_REUSEPORT模式下由内核分配连接, 不经过这里
+  std::size_t size = ioservices_.size();
+  std::size_t start = next_ioservice_.fetch_add(1, std::memory_order_relaxed);
+  std::size_t best = start % size;
+  int64_t best_score = std::numeric_limits<int64_t>::max();
+  // 从轮转位置开始找, session数相同时依次分给不同的io_context
+  for (std::size_t i = 0; i < size; ++i) {
+    std::size_t index = (start + i) % size;
+    auto& stats = *stats_[index];
+    int64_t score = stats.sessions_->load(std::memory_order_relaxed);
+    if (stats.lag_us_->load(std::memory_order_relaxed) > lag_limit_us_) {
+      score += kLagPenalty;
+    }
+    if (score < best_score) {
+      best = index;
+      best_score = score;
+    }
   }
-  return service;
+  return ioservices_[best];
+}
+
+std::size_t AsioIOServicePool::Size() const { return ioservices_.size(); }
+
+boost::asio::io_context& AsioIOServicePool::GetIOService(std::size_t index) {
+  return ioservices_[index];
+}
+
+TimingWheel& AsioIOServicePool::GetWheel(const boost::asio::io_context& ioc) {
+  return *wheels_[IndexOf(ioc)];
+}
+
+std::atomic<int64_t>& AsioIOServicePool::SessionCount(
+    const boost::asio::io_context& ioc) {
+  return *stats_[IndexOf(ioc)]->sessions_;
+}
+
+std::size_t AsioIOServicePool::IndexOf(
+    const boost::asio::io_context& ioc) const {
+  return &ioc - ioservices_.data();
+}
+
+void AsioIOServicePool::PinThread(std::size_t index) {
+  if (cpus_.empty()) {
+    return;
+  }
+  int cpu = cpus_[index % cpus_.size()];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    std::cout << "pin io thread " << index << " to cpu " << cpu
+              << " failed, error is " << ret << std::endl;
+  }
+}
+
+void AsioIOServicePool::Probe(std::size_t index) {
+  auto& stats = *stats_[index];
+  stats.expected_ = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(kProbeIntervalMs);
+  stats.probe_.expires_at(stats.expected_);
+  stats.probe_.async_wait([this, index](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    auto& stats = *stats_[index];
+    auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - stats.expected_)
+                   .count();
+    stats.lag_us_->store(lag, std::memory_order_relaxed);
+    Probe(index);
+  });
 }
 
 void AsioIOServicePool::Stop() {
@@ -35,4 +180,4 @@ void AsioIOServicePool::Stop() {
   for (auto& t : threads_) {
     t.join();
   }
-}
\ No newline at end of file
+}
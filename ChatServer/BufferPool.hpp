@@ -0,0 +1,59 @@
+#pragma once
+#include "utilities.hpp"
+
+// 按大小分级的内存池, 每个线程(主要是io_context线程)持有自己的空闲链表,
+// 线程缓存过多时批量归还到全局仓库, 缓存为空时再从仓库批量取回
+class BufferPool {
+ public:
+  // 最小分级64字节, 每级翻倍, 超过最大分级直接走new/delete
+  static constexpr std::size_t kMinClassSize = 64;
+  static constexpr std::size_t kClassCount = 11;
+  static constexpr std::size_t kMaxClassSize = kMinClassSize
+                                               << (kClassCount - 1);
+  // 单个线程每一级最多缓存的块数
+  static constexpr std::size_t kThreadCacheLimit = 64;
+  // 线程缓存与全局仓库之间一次搬运的块数
+  static constexpr std::size_t kBatchSize = 32;
+  // 全局仓库每一级最多保存的字节数, 超出的块直接释放, 流量高峰过后
+  // 不会一直占着内存
+  static constexpr std::size_t kDepotLimitBytes = 4 << 20;
+
+  static char* Allocate(std::size_t size);
+  static void Deallocate(char* ptr, std::size_t size);
+
+ private:
+  static std::size_t SizeClass(std::size_t size);
+};
+
+// 供std::allocate_shared使用, 让节点对象和控制块也从内存池分配
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    return reinterpret_cast<T*>(BufferPool::Allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, std::size_t n) {
+    BufferPool::Deallocate(reinterpret_cast<char*>(ptr), n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooled(Args&&... args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(),
+                                 std::forward<Args>(args)...);
+}
@@ -2,47 +2,207 @@
 
 #include "AsioIOServicePool.hpp"
 #include "CSession.hpp"
+#include "ConfigManager.hpp"
+#include "RouteCache.hpp"
 #include "UserManager.hpp"
 
+namespace {
+std::unique_ptr<tcp::acceptor> MakeReusePortAcceptor(net::io_context& ioc,
+                                                     uint16_t port) {
+  using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET,
+                                                         SO_REUSEPORT>;
+  tcp::endpoint endpoint(net::ip::address_v4::any(), port);
+  auto acceptor = std::make_unique<tcp::acceptor>(ioc);
+  acceptor->open(endpoint.protocol());
+  acceptor->set_option(tcp::acceptor::reuse_address(true));
+  acceptor->set_option(reuse_port(true));
+  acceptor->bind(endpoint);
+  acceptor->listen();
+  return acceptor;
+}
+
+const std::size_t kDefaultDrainBatch = 500;
+const int kDefaultDrainIntervalMs = 200;
+const int kDefaultDrainTimeoutSec = 30;
+const int kDrainPollMs = 100;
+
+int ConfigInt(const std::string& section, const std::string& key,
+              int default_value) {
+  auto value = ConfigManager::GetInstance()[section][key];
+  return value.empty() ? default_value : std::stoi(value);
+}
+}  // namespace
+
 CServer::CServer(net::io_context& ioc, uint16_t port)
     : ioc_(ioc),
-      acceptor_(ioc_, tcp::endpoint(net::ip::address_v4::any(), port)),
-      port_(port) {
-  std::cout << "Server start success, listion to port: " << port << std::endl;
-  StartAccpet();
+      port_(port),
+      reuse_port_(ConfigManager::GetInstance()["SelfServer"]["ReusePort"] ==
+                  "true"),
+      draining_(false),
+      drain_timer_(ioc),
+      drain_next_(0),
+      drain_batch_(kDefaultDrainBatch),
+      drain_interval_(kDefaultDrainIntervalMs) {
+  if (reuse_port_) {
+    auto pool = AsioIOServicePool::GetInstance();
+    for (std::size_t i = 0; i < pool->Size(); ++i) {
+      acceptors_.push_back(
+          MakeReusePortAcceptor(pool->GetIOService(i), port));
+    }
+  } else {
+    acceptors_.push_back(std::make_unique<tcp::acceptor>(
+        ioc_, tcp::endpoint(net::ip::address_v4::any(), port)));
+  }
+  std::cout << "Server start success, listion to port: " << port
+            << ", acceptor count " << acceptors_.size() << std::endl;
+  for (std::size_t i = 0; i < acceptors_.size(); ++i) {
+    StartAccpet(i);
+  }
 }
 
 CServer::~CServer() {}
 
-void CServer::ClearSession(std::string session_id) {
-  if (sessions_.find(session_id) != sessions_.end()) {
-    UserManager::GetInstance()->RemoveUserSession(
-        sessions_[session_id]->GetUserId());
-  }
+uint16_t CServer::GetPort() const {
+  return acceptors_.front()->local_endpoint().port();
+}
 
+void CServer::ClearSession(uint64_t session_id) {
+  // 查找和删除在同一次加锁内完成, 同一个session重复清理时只有一次生效
+  std::shared_ptr<CSession> session;
   {
-    std::lock_guard<std::mutex> lock(mtx_);
-    sessions_.erase(session_id);
+    auto& shard = ShardOf(session_id);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    auto it = shard.sessions_.find(session_id);
+    if (it == shard.sessions_.end()) {
+      return;
+    }
+    session = std::move(it->second);
+    shard.sessions_.erase(it);
+  }
+  int uid = session->GetUserId();
+  if (uid > 0 &&
+      UserManager::GetInstance()->RemoveUserSession(uid, session)) {
+    // 用户已经离开本服务器, 其它服务器不必再把消息发到这里
+    RouteCache::GetInstance()->PublishLogout(uid);
   }
 }
 
-void CServer::HandleAccept(std::shared_ptr<CSession> session,
+void CServer::Drain(std::function<void()> on_done) {
+  on_drained_ = std::move(on_done);
+  draining_ = true;
+  // acceptor不是线程安全的, 在各自的io_context上关闭
+  for (auto& acceptor : acceptors_) {
+    auto* target = acceptor.get();
+    net::post(target->get_executor(), [target]() {
+      boost::system::error_code ec;
+      target->close(ec);
+    });
+  }
+
+  drain_batch_ = std::max(
+      ConfigInt("Drain", "BatchSize", static_cast<int>(kDefaultDrainBatch)),
+      1);
+  drain_interval_ = std::chrono::milliseconds(
+      ConfigInt("Drain", "BatchIntervalMs", kDefaultDrainIntervalMs));
+  drain_deadline_ =
+      std::chrono::steady_clock::now() +
+      std::chrono::seconds(
+          ConfigInt("Drain", "TimeoutSec", kDefaultDrainTimeoutSec));
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    for (auto& item : shard.sessions_) {
+      drain_sessions_.push_back(item.second);
+    }
+  }
+  std::cout << "server draining, session count is " << drain_sessions_.size()
+            << std::endl;
+  DrainBatch();
+}
+
+void CServer::DrainBatch() {
+  // 分批通知, 避免所有客户端同时回到GateServer重新登录
+  std::size_t end = std::min(drain_next_ + drain_batch_, drain_sessions_.size());
+  for (; drain_next_ < end; ++drain_next_) {
+    auto session = drain_sessions_[drain_next_].lock();
+    if (session != nullptr) {
+      session->Drain(ErrorCodes::ServerDraining);
+    }
+  }
+  if (drain_next_ >= drain_sessions_.size()) {
+    drain_sessions_.clear();
+    WaitDrained();
+    return;
+  }
+  drain_timer_.expires_after(drain_interval_);
+  drain_timer_.async_wait([this](boost::system::error_code ec) {
+    if (!ec) {
+      DrainBatch();
+    }
+  });
+}
+
+void CServer::WaitDrained() {
+  std::size_t count = SessionCount();
+  if (count == 0 || std::chrono::steady_clock::now() >= drain_deadline_) {
+    std::cout << "server drained, remaining session count is " << count
+              << std::endl;
+    on_drained_();
+    return;
+  }
+  drain_timer_.expires_after(std::chrono::milliseconds(kDrainPollMs));
+  drain_timer_.async_wait([this](boost::system::error_code ec) {
+    if (!ec) {
+      WaitDrained();
+    }
+  });
+}
+
+std::size_t CServer::SessionCount() {
+  std::size_t count = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    count += shard.sessions_.size();
+  }
+  return count;
+}
+
+CServer::Shard& CServer::ShardOf(uint64_t session_id) {
+  // 低位是自增计数, 直接取模即可均匀分布
+  return shards_[session_id % kShardCount];
+}
+
+void CServer::HandleAccept(std::size_t index,
+                           std::shared_ptr<CSession> session,
                            const boost::system::error_code& ec) {
   if (!ec) {
+    // 先登记再启动, 启动后立即断开的session也能被清理
+    {
+      auto& shard = ShardOf(session->GetSessionId());
+      std::lock_guard<std::mutex> lock(shard.mtx_);
+      shard.sessions_[session->GetSessionId()] = session;
+    }
     session->Start();
-    std::lock_guard<std::mutex> lock(mtx_);
-    sessions_[session->GetSeesionId()] = session;
   } else {
     std::cout << "Session accept failed, error is " << ec.what() << std::endl;
   }
-  StartAccpet();
+  // 下线时acceptor已关闭, 不再继续接受
+  if (draining_) {
+    return;
+  }
+  StartAccpet(index);
 }
 
-void CServer::StartAccpet() {
-  auto& ioc = AsioIOServicePool::GetInstance()->GetIOService();
+void CServer::StartAccpet(std::size_t index) {
+  auto& acceptor = *acceptors_[index];
+  // SO_REUSEPORT模式下session留在接受它的io_context上, 不再跨线程转交
+  auto& ioc = reuse_port_
+                  ? static_cast<net::io_context&>(
+                        acceptor.get_executor().context())
+                  : AsioIOServicePool::GetInstance()->GetIOService();
   std::shared_ptr<CSession> new_session = std::make_shared<CSession>(ioc, this);
-  acceptor_.async_accept(new_session->GetSocket(),
-                         [=](boost::system::error_code ec) {
-                           this->HandleAccept(new_session, ec);
-                         });
+  acceptor.async_accept(
+      new_session->GetSocket(),
+      [this, index, new_session](boost::system::error_code ec) {
+        this->HandleAccept(index, new_session, ec);
+      });
 }
@@ -1,209 +1,791 @@
 #include "CSession.hpp"
 
+#include "AsioIOServicePool.hpp"
+#include "BufferPool.hpp"
 #include "CServer.hpp"
+#include "Compressor.hpp"
+#include "ConfigManager.hpp"
 #include "LogicSystem.hpp"
+#include "Metrics.hpp"
+#include "MsgCodec.hpp"
 #include "MsgNode.hpp"
+#include "TimingWheel.hpp"
+
+namespace {
+uint32_t MaxRecvBytes() {
+  static const uint32_t max_recv_bytes = []() {
+    auto value = ConfigManager::GetInstance()["Session"]["MaxRecvBytes"];
+    if (value.empty()) {
+      return kDefaultMaxRecvBytes;
+    }
+    return static_cast<uint32_t>(std::stoul(value));
+  }();
+  return max_recv_bytes;
+}
+
+// logic积压的读取水位, worker积压超过high_时有消息在排队的session暂停读取,
+// 单个session排队超过session_high_时无论worker是否积压都暂停.
+// 没有消息在排队的session总能读取, 积压时每个session仍至少有一条在处理
+struct ReadWatermarks {
+  int64_t high_;
+  int64_t low_;
+  int session_high_;
+  int session_low_;
+};
+
+const ReadWatermarks& Watermarks() {
+  static const ReadWatermarks marks = []() {
+    auto& cfg = ConfigManager::GetInstance();
+    ReadWatermarks marks;
+    auto high = cfg["Logic"]["HighWatermark"];
+    marks.high_ = high.empty() ? kMaxRecvQue / 2 : std::stoll(high);
+    auto low = cfg["Logic"]["LowWatermark"];
+    marks.low_ = low.empty() ? marks.high_ / 2 : std::stoll(low);
+    auto session_high = cfg["Logic"]["SessionHighWatermark"];
+    marks.session_high_ = session_high.empty() ? kDefaultSessionHighWater
+                                               : std::stoi(session_high);
+    marks.session_high_ = std::max(marks.session_high_, 1);
+    marks.session_low_ = marks.session_high_ / 2;
+    return marks;
+  }();
+  return marks;
+}
+
+// 发送队列超出预算或者判定为慢消费者时的处理方式
+enum SlowConsumerPolicy {
+  // 丢弃好友申请/认证通知, 客户端重新登录时会拉取完整的申请列表
+  kPolicyDropNotify,
+  // 同一种通知只保留最新一条, 等客户端追上后再发
+  kPolicyCoalesce,
+  // 直接断开
+  kPolicyDisconnect,
+};
+
+struct SendLimits {
+  int64_t budget_;
+  int64_t slow_ms_;
+  SlowConsumerPolicy policy_;
+};
+
+const SendLimits& Limits() {
+  static const SendLimits limits = []() {
+    auto& cfg = ConfigManager::GetInstance();
+    SendLimits limits;
+    auto budget = cfg["Session"]["SendBudgetBytes"];
+    limits.budget_ =
+        budget.empty() ? kDefaultSendBudgetBytes : std::stoll(budget);
+    auto slow_ms = cfg["Session"]["SlowConsumerMs"];
+    limits.slow_ms_ =
+        slow_ms.empty() ? kDefaultSlowConsumerMs : std::stoll(slow_ms);
+    auto policy = cfg["Session"]["SlowConsumerPolicy"];
+    if (policy == "coalesce") {
+      limits.policy_ = kPolicyCoalesce;
+    } else if (policy == "disconnect") {
+      limits.policy_ = kPolicyDisconnect;
+    } else {
+      limits.policy_ = kPolicyDropNotify;
+    }
+    return limits;
+  }();
+  return limits;
+}
+
+// 可以丢弃或合并的通知, 聊天消息和请求的回包不在其中
+bool IsDroppableNotify(short msg_id) {
+  return msg_id == ID_NOTIFY_ADD_FRIEND_REQ ||
+         msg_id == ID_NOTIFY_AUTH_FRIEND_REQ;
+}
+
+// 会话id为 服务器id(16位) | 生成线程的序号(16位) | 线程内计数(32位),
+// 只用线程本地计数, 不需要读取系统熵源, 也不需要加锁
+uint64_t NextSessionId() {
+  static const uint64_t server_bits = []() {
+    auto& cfg = ConfigManager::GetInstance();
+    auto server_id = cfg["SelfServer"]["ServerId"];
+    uint64_t id = server_id.empty()
+                      ? std::hash<std::string>()(cfg["SelfServer"]["Name"])
+                      : std::stoull(server_id);
+    return (id & 0xffff) << 48;
+  }();
+  static std::atomic<uint64_t> thread_count(0);
+  thread_local uint64_t thread_bits = (thread_count++ & 0xffff) << 32;
+  thread_local uint32_t counter = 0;
+  return server_bits | thread_bits | ++counter;
+}
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
 
 CSession::CSession(net::io_context& ioc, CServer* server)
     : socket_(ioc),
+      recv_buf_(kRecvBufLen),
+      recv_version_(kProtocolV1),
+      max_recv_bytes_(MaxRecvBytes()),
       server_(server),
       close_(false),
-      head_parsed_(false),
-      user_uid_(0) {
-  boost::uuids::uuid id = boost::uuids::random_generator()();
-  session_id_ = boost::uuids::to_string(id);
+      wheel_(&AsioIOServicePool::GetInstance()->GetWheel(ioc)),
+      last_active_tick_(0),
+      close_after_flush_(false),
+      session_count_(AsioIOServicePool::GetInstance()->SessionCount(ioc)),
+      send_que_size_(0),
+      send_que_bytes_(0),
+      write_start_ms_(0),
+      drain_rate_(0),
+      has_coalesced_(false),
+      kicked_(false),
+      write_scheduled_(false),
+      sending_bytes_(0),
+      send_version_(kProtocolV1),
+      user_uid_(0),
+      codec_(kCodecJson),
+      compress_(false),
+      logic_pending_(0),
+      read_paused_(false) {
+  session_id_ = NextSessionId();
+  session_count_++;
 }
 
-CSession::~CSession() {}
+CSession::~CSession() {
+  session_count_--;
+  // 断开时未写完的字节不再计入全局的发送积压
+  Metrics::GetInstance()->Counter("session.send_que_bytes") -=
+      send_que_bytes_.load();
+}
 
 tcp::socket& CSession::GetSocket() { return socket_; }
 
-std::string CSession::GetSeesionId() const { return session_id_; }
+uint64_t CSession::GetSessionId() const { return session_id_; }
 
 void CSession::SetUserId(int id) { user_uid_ = id; }
 
 int CSession::GetUserId() const { return user_uid_; }
 
-void CSession::Start() { AsyncReadHead(kHeadTotalLen); }
+void CSession::SetCodec(int codec) { codec_ = codec; }
+
+int CSession::GetCodec() const { return codec_; }
+
+int CSession::GetProtocolVersion() const { return recv_version_; }
+
+void CSession::SetCompress(bool compress) { compress_ = compress; }
 
-void CSession::Send(char* msg, short max_length, short msgid) {
-  std::lock_guard<std::mutex> lock(send_lock_);
-  int send_que_size = send_que_.size();
-  if (send_que_size > kMaxSendQue) {
-    std::cout << "session: " << session_id_ << " send que fulled, size is "
-              << kMaxSendQue << std::endl;
+bool CSession::GetCompress() const { return compress_; }
+
+void CSession::Start() {
+  // 由accept线程调用, 加入时间轮要回到session所属的io线程
+  auto self = shared_from_this();
+  net::post(socket_.get_executor(), [self, this]() {
+    last_active_tick_ = wheel_->Now();
+    wheel_->Add(self);
+    AsyncRead();
+  });
+}
+
+void CSession::Send(const char* msg, short max_length, short msgid) {
+  Send(MakePooled<SendNode>(msg, max_length, msgid));
+}
+
+void CSession::Send(const std::string& msg, short msgid) {
+  Send(MakePooled<SendNode>(msg.data(), msg.length(), msgid));
+}
+
+void CSession::Send(std::shared_ptr<SendNode> node) {
+  // 可能在logic线程或grpc线程调用, 只入队不碰socket
+  if (kicked_.load(std::memory_order_relaxed)) {
     return;
   }
 
-  send_que_.push(std::make_shared<SendNode>(msg, max_length, msgid));
-  if (send_que_size > 0) {
+  // 压缩在调用线程完成, 不占用io线程. 协商协议版本的回包不压缩
+  if (compress_.load(std::memory_order_relaxed) && node->switch_version_ == 0) {
+    auto compressed = Compressor::GetInstance()->Compress(node);
+    if (compressed != nullptr) {
+      node = std::move(compressed);
+    }
+  }
+
+  if (!AdmitSend(node)) {
     return;
   }
-  auto& msgnode = send_que_.front();
-  boost::asio::async_write(
-      socket_, boost::asio::buffer(msgnode->data_, msgnode->total_len_),
-      [this](boost::system::error_code ec, size_t) {
-        this->HandleWrite(ec, shared_from_this());
-      });
+  send_que_.Push(std::move(node));
+  send_que_size_.fetch_add(1, std::memory_order_relaxed);
+  if (write_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  // 由session所在的io_context线程统一发起写操作
+  auto self = shared_from_this();
+  net::post(socket_.get_executor(), [self, this]() { StartWrite(); });
 }
 
-void CSession::Send(std::string msg, short msgid) {
-  std::lock_guard<std::mutex> lock(send_lock_);
-  int send_que_size = send_que_.size();
-  if (send_que_size > kMaxSendQue) {
-    std::cout << "session: " << session_id_ << " send que fulled, size is "
-              << kMaxSendQue << std::endl;
-    return;
+bool CSession::AdmitSend(std::shared_ptr<SendNode>& node) {
+  static auto& queued_bytes =
+      Metrics::GetInstance()->Counter("session.send_que_bytes");
+  static auto& dropped =
+      Metrics::GetInstance()->Counter("session.send_dropped_notify");
+  static auto& coalesced =
+      Metrics::GetInstance()->Counter("session.send_coalesced");
+
+  const auto& limits = Limits();
+  int64_t len = node->BodyLen();
+  int64_t queued = send_que_bytes_.load(std::memory_order_relaxed);
+  bool over_budget = queued + len > limits.budget_;
+  if (!over_budget && !IsSlowConsumer(queued)) {
+    send_que_bytes_ += len;
+    queued_bytes += len;
+    return true;
   }
 
-  send_que_.push(std::make_shared<SendNode>(msg.c_str(), msg.length(), msgid));
-  if (send_que_size > 0) {
-    return;
+  if (limits.policy_ == kPolicyDisconnect) {
+    Kick(ErrorCodes::SlowConsumer);
+    return false;
   }
-  auto& msgnode = send_que_.front();
-  boost::asio::async_write(
-      socket_, boost::asio::buffer(msgnode->data_, msgnode->total_len_),
-      [this](boost::system::error_code ec, size_t) {
-        this->HandleWrite(ec, shared_from_this());
-      });
+  if (IsDroppableNotify(node->msg_id_)) {
+    if (limits.policy_ == kPolicyDropNotify) {
+      dropped++;
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(coalesce_mtx_);
+      coalesced_[node->msg_id_] = std::move(node);
+    }
+    has_coalesced_ = true;
+    coalesced++;
+    // 写操作可能刚好在判定之后结束, 确保有人把暂存的通知发出去
+    if (!write_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      auto self = shared_from_this();
+      net::post(socket_.get_executor(), [self, this]() { StartWrite(); });
+    }
+    return false;
+  }
+  // 聊天消息和回包在预算内照常排队, 超出预算宁可断开也不悄悄丢弃
+  if (over_budget) {
+    Kick(ErrorCodes::SlowConsumer);
+    return false;
+  }
+  send_que_bytes_ += len;
+  queued_bytes += len;
+  return true;
 }
 
-void CSession::Close() {
-  socket_.close();
-  close_ = true;
+bool CSession::IsSlowConsumer(int64_t queued) const {
+  const auto& limits = Limits();
+  int64_t start = write_start_ms_.load(std::memory_order_relaxed);
+  if (start != 0 && NowMs() - start > limits.slow_ms_) {
+    return true;
+  }
+  int64_t rate = drain_rate_.load(std::memory_order_relaxed);
+  return rate > 0 && queued * 1000 / rate > limits.slow_ms_;
 }
 
-void CSession::AsyncReadBody(int total_len) {
+bool CSession::FlushCoalesced() {
+  if (!has_coalesced_.exchange(false, std::memory_order_acq_rel)) {
+    return false;
+  }
+  std::map<short, std::shared_ptr<SendNode> > nodes;
+  {
+    std::lock_guard<std::mutex> lock(coalesce_mtx_);
+    nodes.swap(coalesced_);
+  }
+  static auto& queued_bytes =
+      Metrics::GetInstance()->Counter("session.send_que_bytes");
+  for (auto& item : nodes) {
+    int64_t len = item.second->BodyLen();
+    send_que_bytes_ += len;
+    queued_bytes += len;
+    send_que_.Push(std::move(item.second));
+    send_que_size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return !nodes.empty();
+}
+
+void CSession::Kick(int reason) {
+  static auto& kicks =
+      Metrics::GetInstance()->Counter("session.slow_disconnects");
+  if (kicked_.exchange(true)) {
+    return;
+  }
+  kicks++;
+  std::cout << "session: " << session_id_ << " uid " << user_uid_
+            << " is a slow consumer, queued bytes " << send_que_bytes_
+            << ", disconnect with reason " << reason << std::endl;
   auto self = shared_from_this();
-  AsyncReadFull(total_len, [self, this, total_len](boost::system::error_code ec,
-                                                   size_t bytes_transfered) {
-    try {
-      if (ec) {
-        std::cout << "handle read failed, error is " << ec.what() << std::endl;
-        Close();
-        server_->ClearSession(session_id_);
-        return;
-      }
-      if (bytes_transfered < total_len) {
-        std::cout << "read length not match, read [" << bytes_transfered
-                  << "] , total [" << total_len << "]" << std::endl;
-        Close();
-        server_->ClearSession(session_id_);
-        return;
+  net::post(socket_.get_executor(), [self, this, reason]() {
+    if (close_) {
+      return;
+    }
+    // 没有写操作在进行时尝试把原因直接写给客户端, 写不完也不等待.
+    // 写操作进行中再写会打乱消息边界, 只能直接断开
+    if (sending_.empty()) {
+      chat::KickNotify notify;
+      notify.set_error(reason);
+      auto node = MsgCodec::Encode(codec_, notify, ID_NOTIFY_KICK_REQ);
+      net::const_buffer buffer;
+      if (node != nullptr && node->Frame(send_version_, buffer)) {
+        boost::system::error_code ec;
+        socket_.non_blocking(true, ec);
+        socket_.write_some(buffer, ec);
       }
-      memcpy(recv_msg_node_->data_, data_, bytes_transfered);
-      recv_msg_node_->curr_len_ += bytes_transfered;
-      recv_msg_node_->data_[recv_msg_node_->total_len_] = '\0';
-      LogicSystem::GetInstance()->PostMsgToQue(
-          std::make_shared<LogicNode>(self, recv_msg_node_));
-      AsyncReadHead(kHeadTotalLen);
-
-    } catch (std::exception& e) {
-      std::cout << "Exception code is " << e.what() << std::endl;
     }
+    Close();
+    server_->ClearSession(session_id_);
   });
 }
 
-void CSession::AsyncReadHead(int total_len) {
+void CSession::StartWrite() {
+  static auto& write_calls =
+      Metrics::GetInstance()->Counter("session.write_calls");
+  static auto& write_frames =
+      Metrics::GetInstance()->Counter("session.write_frames");
+  static auto& write_bytes =
+      Metrics::GetInstance()->Counter("session.write_bytes");
+  static auto& queued_bytes =
+      Metrics::GetInstance()->Counter("session.send_que_bytes");
+
+  // 至少取一个节点, 之后按节点数和字节数上限继续合并
+  std::size_t bytes = 0;
+  sending_bytes_ = 0;
+  while (sending_.size() < kMaxGatherNodes) {
+    if (pending_ == nullptr && !send_que_.Pop(pending_)) {
+      break;
+    }
+    if (!sending_.empty() && bytes + pending_->BodyLen() > kMaxGatherBytes) {
+      break;
+    }
+    net::const_buffer buffer;
+    if (!pending_->Frame(send_version_, buffer)) {
+      std::cout << "session: " << session_id_ << " drop msg "
+                << pending_->msg_id_ << ", can not frame for protocol v"
+                << send_version_ << std::endl;
+      send_que_size_.fetch_sub(1, std::memory_order_relaxed);
+      send_que_bytes_ -= pending_->BodyLen();
+      queued_bytes -= pending_->BodyLen();
+      pending_ = nullptr;
+      continue;
+    }
+    if (pending_->switch_version_ != 0) {
+      send_version_ = pending_->switch_version_;
+    }
+    bytes += buffer.size();
+    sending_bytes_ += pending_->BodyLen();
+    send_bufs_.push_back(buffer);
+    sending_.push_back(std::move(pending_));
+    pending_ = nullptr;
+  }
+
+  if (sending_.empty()) {
+    // 客户端已经追上, 发出暂存的通知
+    if (FlushCoalesced()) {
+      StartWrite();
+      return;
+    }
+    // 下线通知之前的消息都已写完, 保持write_scheduled_不再发起写操作
+    if (close_after_flush_ && send_que_.Empty()) {
+      Close();
+      server_->ClearSession(session_id_);
+      return;
+    }
+    // 清除标记后再检查一次, 避免与刚入队的生产者互相错过. 清除必须用
+    // 读改写操作, 普通store可能被重排到下面的Empty检查之后
+    write_scheduled_.exchange(false, std::memory_order_acq_rel);
+    if (send_que_.Empty() ||
+        write_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    StartWrite();
+    return;
+  }
+
+  send_que_size_.fetch_sub(sending_.size(), std::memory_order_relaxed);
+  write_calls++;
+  write_frames += sending_.size();
+  write_bytes += bytes;
+  write_start_ms_.store(NowMs(), std::memory_order_relaxed);
+  // self保证写完成之前session不被析构
   auto self = shared_from_this();
-  AsyncReadFull(kHeadTotalLen, [self, this](boost::system::error_code ec,
-                                            size_t bytes_transfered) {
-    try {
-      if (ec) {
-        std::cout << "Handle read failed, error is " << ec.what() << std::endl;
-        Close();
-        server_->ClearSession(session_id_);
-        return;
-      }
+  net::async_write(socket_, send_bufs_,
+                   [self, this](boost::system::error_code ec, size_t) {
+                     HandleWrite(ec);
+                   });
+}
 
-      if (bytes_transfered < kHeadTotalLen) {
-        std::cout << "read length not match, read [" << bytes_transfered
-                  << "] , total [" << kHeadTotalLen << "]" << std::endl;
-        Close();
-        server_->ClearSession(session_id_);
-        return;
-      }
+void CSession::Close() {
+  socket_.close();
+  close_ = true;
+}
 
-      recv_head_node_->Clear();
-      memcpy(recv_head_node_->data_, data_, bytes_transfered);
-
-      // 获取头部MSGID数据
-      short msg_id = 0;
-      memcpy(&msg_id, recv_head_node_->data_, kHeadIdLen);
-      // 网络字节序转化为本地字节序
-      msg_id = boost::asio::detail::socket_ops::network_to_host_short(msg_id);
-      std::cout << "msg_id is " << msg_id << std::endl;
-      // id非法
-      if (msg_id > kMaxLength) {
-        std::cout << "Invalid msg_id is " << msg_id << std::endl;
-        server_->ClearSession(session_id_);
-        return;
-      }
-      short msg_len = 0;
-      memcpy(&msg_len, recv_head_node_->data_ + kHeadIdLen, kHeadDataLen);
-      // 网络字节序转化为本地字节序
-      msg_len = boost::asio::detail::socket_ops::network_to_host_short(msg_len);
-      std::cout << "msg_len is " << msg_len << std::endl;
-
-      // 消息长度非法
-      if (msg_len > kMaxLength) {
-        std::cout << "Invalid data length is " << msg_len << std::endl;
-        server_->ClearSession(session_id_);
-        return;
-      }
+bool CSession::IsClosed() const { return close_; }
 
-      recv_msg_node_ = std::make_shared<RecvNode>(msg_len, msg_id);
-      AsyncReadBody(msg_len);
-    } catch (std::exception& e) {
-      std::cout << "Exception: " << e.what() << std::endl;
+bool CSession::IsReadPaused() const { return read_paused_; }
+
+uint64_t CSession::LastActiveTick() const { return last_active_tick_; }
+
+void CSession::CloseIdle() {
+  std::cout << "session: " << session_id_ << " uid " << user_uid_
+            << " idle timeout, close" << std::endl;
+  Close();
+  server_->ClearSession(session_id_);
+}
+
+void CSession::Drain(int reason) {
+  chat::KickNotify notify;
+  notify.set_error(reason);
+  MsgCodec::Send(shared_from_this(), notify, ID_NOTIFY_KICK_REQ);
+  auto self = shared_from_this();
+  net::post(socket_.get_executor(), [self, this]() {
+    if (close_) {
+      return;
+    }
+    close_after_flush_ = true;
+    // 通知可能因发送预算没有入队, 此时由这里发起一次写操作来断开
+    if (!write_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      StartWrite();
     }
   });
 }
 
-// 读取完整长度
-void CSession::AsyncReadFull(
-    std::size_t maxLength,
-    std::function<void(const boost::system::error_code&, std::size_t)>
-        handler) {
-  ::memset(data_, 0, kMaxLength);
-  AsyncReadLen(0, maxLength, handler);
+void CSession::AsyncRead() {
+  // 正在接收放不进环形缓冲区的大消息
+  if (body_node_ != nullptr) {
+    AsyncReadBody();
+    return;
+  }
+  auto self = shared_from_this();
+  socket_.async_read_some(
+      recv_buf_.PrepareBuffers(),
+      [self, this](boost::system::error_code ec, size_t bytes_transfered) {
+        try {
+          if (ec) {
+            std::cout << "handle read failed, error is " << ec.what()
+                      << std::endl;
+            Close();
+            server_->ClearSession(session_id_);
+            return;
+          }
+          last_active_tick_ = wheel_->Now();
+          recv_buf_.Commit(bytes_transfered);
+          if (!ParseFrames()) {
+            Close();
+            server_->ClearSession(session_id_);
+            return;
+          }
+          ContinueRead();
+        } catch (std::exception& e) {
+          std::cout << "Exception code is " << e.what() << std::endl;
+        }
+      });
 }
 
-// 读取指定字节
-void CSession::AsyncReadLen(
-    std::size_t read_len, std::size_t total_len,
-    std::function<void(const boost::system::error_code&, std::size_t)>
-        handler) {
+void CSession::AsyncReadBody() {
   auto self = shared_from_this();
+  // 逐段读取而不是一次读满, 慢速上传的大消息每收到一段都刷新空闲时间,
+  // 不会在传输过程中被时间轮当作空闲连接关闭
   socket_.async_read_some(
-      net::buffer(data_ + read_len, total_len - read_len),
-      [=](boost::system::error_code ec, size_t bytes_transfered) {
-        if (ec) {
-          handler(ec, read_len + bytes_transfered);
-          return;
-        }
-        if (read_len + bytes_transfered >= total_len) {
-          handler(ec, read_len + bytes_transfered);
-          return;
+      net::buffer(body_node_->data_ + body_node_->curr_len_,
+                  body_node_->total_len_ - body_node_->curr_len_),
+      [self, this](boost::system::error_code ec, size_t bytes_transfered) {
+        try {
+          if (ec) {
+            std::cout << "handle read body failed, error is " << ec.what()
+                      << std::endl;
+            Close();
+            server_->ClearSession(session_id_);
+            return;
+          }
+          last_active_tick_ = wheel_->Now();
+          body_node_->curr_len_ += bytes_transfered;
+          if (body_node_->curr_len_ < body_node_->total_len_) {
+            AsyncReadBody();
+            return;
+          }
+          auto recv_node = std::move(body_node_);
+          body_node_ = nullptr;
+          if (!DispatchFrame(recv_node)) {
+            Close();
+            server_->ClearSession(session_id_);
+            return;
+          }
+          ContinueRead();
+        } catch (std::exception& e) {
+          std::cout << "Exception code is " << e.what() << std::endl;
         }
-        AsyncReadLen(read_len + bytes_transfered, total_len, handler);
       });
 }
 
-void CSession::HandleWrite(const boost::system::error_code& ec,
-                           std::shared_ptr<CSession> shared_self) {
+void CSession::ContinueRead() {
+  static auto& paused = Metrics::GetInstance()->Counter("session.read_paused");
+  if (blocked_msg_ == nullptr && !ShouldPauseRead()) {
+    AsyncRead();
+    return;
+  }
+  // 不再发起读取, 内核接收缓冲区写满后由TCP流控让客户端放慢发送
+  read_paused_ = true;
+  paused++;
+  if (blocked_msg_ != nullptr) {
+    // 登记之前worker可能已经取空队列, 登记后再投递一次
+    LogicSystem::GetInstance()->WaitForSpace(shared_from_this());
+    if (!PostBlocked()) {
+      return;
+    }
+  }
+  // 置位后再检查一次, 避免与刚处理完最后一条消息的logic线程互相错过.
+  // 放到下一轮执行, 不在这里递归解析
+  if (CanResumeRead() && read_paused_.exchange(false)) {
+    auto self = shared_from_this();
+    net::post(socket_.get_executor(), [self, this]() { ResumeRead(); });
+  }
+}
+
+void CSession::ResumeRead() {
+  if (close_) {
+    // 暂存的消息持有session, 断开后释放
+    blocked_msg_ = nullptr;
+    return;
+  }
+  // 队列仍然满时由ContinueRead重新登记等待
+  if (blocked_msg_ != nullptr && !PostBlocked()) {
+    ContinueRead();
+    return;
+  }
+  if (!ParseFrames()) {
+    Close();
+    server_->ClearSession(session_id_);
+    return;
+  }
+  ContinueRead();
+}
+
+bool CSession::ShouldPauseRead() const {
+  const auto& marks = Watermarks();
+  int pending = logic_pending_;
+  if (pending >= marks.session_high_) {
+    return true;
+  }
+  return pending > 0 &&
+         LogicSystem::GetInstance()->Backlog(this) >= marks.high_;
+}
+
+bool CSession::CanResumeRead() const {
+  const auto& marks = Watermarks();
+  int pending = logic_pending_;
+  if (pending == 0) {
+    return true;
+  }
+  return pending <= marks.session_low_ &&
+         LogicSystem::GetInstance()->Backlog(this) <= marks.low_;
+}
+
+void CSession::OnLogicDone() {
+  logic_pending_--;
+  if (!read_paused_ || !CanResumeRead() || !read_paused_.exchange(false)) {
+    return;
+  }
+  // 在logic线程调用, 解析和读取要回到socket所属的io线程进行
+  auto self = shared_from_this();
+  net::post(socket_.get_executor(), [self, this]() { ResumeRead(); });
+}
+
+int CSession::GetLogicPending() const { return logic_pending_; }
+
+void CSession::OnLogicSpace() {
+  if (!read_paused_.exchange(false)) {
+    return;
+  }
+  auto self = shared_from_this();
+  net::post(socket_.get_executor(), [self, this]() { ResumeRead(); });
+}
+
+bool CSession::ParseHead(const char* head, short& msg_id, uint16_t& flags,
+                         uint32_t& msg_len) {
+  // 获取头部MSGID数据
+  uint16_t id_net = 0;
+  memcpy(&id_net, head, kHeadIdLen);
+  // 网络字节序转化为本地字节序
+  msg_id = boost::asio::detail::socket_ops::network_to_host_short(id_net);
+  // id非法
+  if (msg_id < 0 || msg_id > kMaxLength) {
+    std::cout << "Invalid msg_id is " << msg_id << std::endl;
+    return false;
+  }
+
+  flags = 0;
+  if (recv_version_ == kProtocolV2) {
+    uint16_t flags_net = 0;
+    memcpy(&flags_net, head + kHeadIdLen, kHeadFlagsLen);
+    flags = boost::asio::detail::socket_ops::network_to_host_short(flags_net);
+    uint32_t len_net = 0;
+    memcpy(&len_net, head + kHeadIdLen + kHeadFlagsLen, kHeadDataLenV2);
+    msg_len = boost::asio::detail::socket_ops::network_to_host_long(len_net);
+    if (msg_len > max_recv_bytes_) {
+      std::cout << "Invalid data length is " << msg_len << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  uint16_t len_net = 0;
+  memcpy(&len_net, head + kHeadIdLen, kHeadDataLen);
+  msg_len = boost::asio::detail::socket_ops::network_to_host_short(len_net);
+  // 消息长度非法
+  if (msg_len > kMaxLength) {
+    std::cout << "Invalid data length is " << msg_len << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool CSession::ParseFrames() {
+  while (true) {
+    // 每条消息投递前检查, 一次读到的小消息很多时也不会超过水位
+    if (blocked_msg_ != nullptr || ShouldPauseRead()) {
+      break;
+    }
+    std::size_t head_len =
+        recv_version_ == kProtocolV2 ? kHeadTotalLenV2 : kHeadTotalLen;
+    if (recv_buf_.Size() < head_len) {
+      break;
+    }
+    char head[kHeadTotalLenV2];
+    recv_buf_.Peek(head, head_len);
+    short msg_id = 0;
+    uint16_t flags = 0;
+    uint32_t msg_len = 0;
+    if (!ParseHead(head, msg_id, flags, msg_len)) {
+      return false;
+    }
+
+    // 消息体还没收全, 等待下一次读取
+    if (recv_buf_.Size() < head_len + msg_len) {
+      // 环形缓冲区放不下的大消息, 已收到的部分转入消息节点, 剩余部分直接读入
+      if (head_len + msg_len > recv_buf_.Capacity()) {
+        recv_buf_.Consume(head_len);
+        body_node_ = MakePooled<RecvNode>(msg_len, msg_id);
+        body_node_->flags_ = flags;
+        body_node_->curr_len_ = recv_buf_.Size();
+        recv_buf_.Read(body_node_->data_, body_node_->curr_len_);
+      }
+      break;
+    }
+
+    recv_buf_.Consume(head_len);
+    auto recv_node = MakePooled<RecvNode>(msg_len, msg_id);
+    recv_node->flags_ = flags;
+    recv_buf_.Read(recv_node->data_, msg_len);
+    recv_node->curr_len_ = msg_len;
+    if (!DispatchFrame(recv_node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CSession::DispatchFrame(std::shared_ptr<RecvNode> recv_node) {
+  if (recv_node->flags_ & kFlagCompressed) {
+    // 未协商压缩的session不接受压缩消息
+    if (!compress_) {
+      std::cout << "session: " << session_id_
+                << " recv compressed msg without negotiation" << std::endl;
+      return false;
+    }
+    recv_node = Compressor::GetInstance()->Decompress(recv_node,
+                                                      max_recv_bytes_);
+    if (recv_node == nullptr) {
+      return false;
+    }
+  }
+  // 协议协商必须在io线程内处理, 之后的字节要按新的消息头解析
+  if (recv_node->msg_id_ == ID_PROTOCOL_REQ) {
+    return HandleProtocolReq(recv_node);
+  }
+  if (recv_node->msg_id_ == ID_HEART_BEAT_REQ) {
+    HandleHeartBeat();
+    return true;
+  }
+  static auto& blocked = Metrics::GetInstance()->Counter("session.blocked");
+  // 队列满时不丢弃, 暂存起来并暂停读取, 有空位后按接收顺序重新投递
+  blocked_msg_ = MakePooled<LogicNode>(shared_from_this(), recv_node);
+  if (!PostBlocked()) {
+    blocked++;
+    std::cout << "session: " << session_id_
+              << " logic queue is full, pause reading at msg "
+              << recv_node->msg_id_ << std::endl;
+  }
+  return true;
+}
+
+bool CSession::PostBlocked() {
+  logic_pending_++;
+  if (!LogicSystem::GetInstance()->PostMsgToQue(blocked_msg_)) {
+    logic_pending_--;
+    return false;
+  }
+  blocked_msg_ = nullptr;
+  return true;
+}
+
+void CSession::HandleHeartBeat() {
+  static auto& heartbeats =
+      Metrics::GetInstance()->Counter("session.heartbeats");
+  heartbeats++;
+  // 读到数据时已经刷新了空闲时间, 这里只回包, 不经过logic
+  chat::HeartBeatRsp rsp;
+  rsp.set_error(ErrorCodes::Success);
+  MsgCodec::Send(shared_from_this(), rsp, ID_HEART_BEAT_RSP);
+}
+
+bool CSession::HandleProtocolReq(std::shared_ptr<RecvNode> recv_node) {
+  // 此时可能尚未登录, 回包使用与请求相同的编码
+  int codec = MsgCodec::IsJson(recv_node->data_, recv_node->curr_len_)
+                  ? kCodecJson
+                  : kCodecProtobuf;
+  chat::ProtocolReq req;
+  chat::ProtocolRsp rsp;
+  if (!MsgCodec::Decode(recv_node->data_, recv_node->curr_len_, req)) {
+    rsp.set_error(ErrorCodes::Error_Json);
+    rsp.set_version(recv_version_);
+    Send(MsgCodec::Encode(codec, rsp, ID_PROTOCOL_RSP));
+    return true;
+  }
+
+  int version = req.version();
+  if (version != kProtocolV2) {
+    version = kProtocolV1;
+  }
+  // 客户端发出协商请求后立即改用新的消息头
+  recv_version_ = version;
+  // v1消息头不能携带压缩标记
+  if (version != kProtocolV2) {
+    compress_ = false;
+  }
+  rsp.set_error(ErrorCodes::Success);
+  rsp.set_version(version);
+  rsp.set_max_len(max_recv_bytes_);
+  // 回包仍使用旧的消息头, 发出之后服务端再切换
+  auto node = MsgCodec::Encode(codec, rsp, ID_PROTOCOL_RSP);
+  node->switch_version_ = version;
+  Send(node);
+  return true;
+}
+
+void CSession::HandleWrite(const boost::system::error_code& ec) {
   try {
     if (!ec) {
-      std::lock_guard<std::mutex> lock(send_lock_);
-      send_que_.pop();
-      if (!send_que_.empty()) {
-        auto& msgnode = send_que_.front();
-        net::async_write(socket_,
-                         net::buffer(msgnode->data_, msgnode->total_len_),
-                         [this](boost::system::error_code ec, size_t) {
-                           this->HandleWrite(ec, shared_from_this());
-                         });
-      }
+      static auto& queued_bytes =
+          Metrics::GetInstance()->Counter("session.send_que_bytes");
+      // 按本次写操作的耗时更新写出速率, 新样本占四分之一
+      int64_t elapsed =
+          std::max<int64_t>(NowMs() - write_start_ms_.load(), 1);
+      int64_t rate = sending_bytes_ * 1000 / elapsed;
+      int64_t prev = drain_rate_.load(std::memory_order_relaxed);
+      drain_rate_.store(prev == 0 ? rate : (prev * 3 + rate) / 4,
+                        std::memory_order_relaxed);
+      write_start_ms_.store(0, std::memory_order_relaxed);
+      send_que_bytes_ -= sending_bytes_;
+      queued_bytes -= sending_bytes_;
+      sending_.clear();
+      send_bufs_.clear();
+      StartWrite();
     } else {
       std::cout << "handle write failed, error is " << ec.what() << std::endl;
       Close();
@@ -1,11 +1,15 @@
 #pragma once
+#include "MpscQueue.hpp"
+#include "RingBuffer.hpp"
 #include "utilities.hpp"
 
 class CServer;
+class LogicNode;
 class LogicSystem;
 class MsgNode;
 class RecvNode;
 class SendNode;
+class TimingWheel;
 
 class CSession : public std::enable_shared_from_this<CSession> {
  public:
@@ -13,46 +17,134 @@ class CSession : public std::enable_shared_from_this<CSession> {
   ~CSession();
 
   tcp::socket& GetSocket();
-  std::string GetSeesionId() const;
+  // 进程内唯一, 日志中直接输出数值
+  uint64_t GetSessionId() const;
   void SetUserId(int id);
   int GetUserId() const;
+  void SetCodec(int codec);
+  int GetCodec() const;
+  // 接收方向当前的消息头版本
+  int GetProtocolVersion() const;
+  // 开启后达到阈值的消息体压缩发送, 只能在v2消息头下使用
+  void SetCompress(bool compress);
+  bool GetCompress() const;
   void Start();
-  void Send(char* msg, short max_length, short msgid);
-  void Send(std::string msg, short msgid);
+  void Send(const char* msg, short max_length, short msgid);
+  void Send(const std::string& msg, short msgid);
+  // 发送已经组装好的节点, 配合SendNode::Adopt可以避免再拷贝一次消息体
+  void Send(std::shared_ptr<SendNode> node);
   void Close();
-  void AsyncReadBody(int total_len);
-  void AsyncReadHead(int total_len);
+  // logic处理完本session的一条消息后调用, 必要时恢复读取
+  void OnLogicDone();
+  // 已投递给logic尚未处理完的消息数, 任意线程读取
+  int GetLogicPending() const;
+  // worker队列腾出空位后由logic线程调用, 恢复读取时重新投递暂存的消息
+  void OnLogicSpace();
+  // 以下函数由时间轮在io线程调用
+  bool IsClosed() const;
+  bool IsReadPaused() const;
+  uint64_t LastActiveTick() const;
+  void CloseIdle();
+  // 服务器下线时调用, 通知客户端到其它服务器重连, 发送队列写完后断开
+  void Drain(int reason);
 
  private:
-  void AsyncReadFull(
-      std::size_t maxLength,
-      std::function<void(const boost::system::error_code&, std::size_t)>
-          handler);
-  void AsyncReadLen(
-      std::size_t read_len, std::size_t total_len,
-      std::function<void(const boost::system::error_code&, std::size_t)>
-          handler);
+  // 一次读取内核中已就绪的全部数据
+  void AsyncRead();
+  // 把放不进环形缓冲区的大消息体直接读入消息节点
+  void AsyncReadBody();
+  bool ParseHead(const char* head, short& msg_id, uint16_t& flags,
+                 uint32_t& msg_len);
+  // 解析环形缓冲区中完整的消息, logic积压时停止, 剩余的字节留到恢复读取
+  // 时再解析. 出现非法消息时返回false
+  bool ParseFrames();
+  bool DispatchFrame(std::shared_ptr<RecvNode> recv_node);
+  // 投递blocked_msg_, worker队列仍然满时返回false
+  bool PostBlocked();
+  bool HandleProtocolReq(std::shared_ptr<RecvNode> recv_node);
+  void HandleHeartBeat();
+  // 读取完成后继续读取, logic积压或队列满时暂停, 由OnLogicDone或
+  // OnLogicSpace恢复
+  void ContinueRead();
+  // 先投递暂存的消息, 再解析暂停期间留在缓冲区中的消息, 最后继续读取
+  void ResumeRead();
+  bool ShouldPauseRead() const;
+  bool CanResumeRead() const;
+  // 按字节预算和慢消费者策略决定消息是否入队, 入队时计入send_que_bytes_
+  bool AdmitSend(std::shared_ptr<SendNode>& node);
+  bool IsSlowConsumer(int64_t queued) const;
+  // 把coalesce策略下暂存的通知放回发送队列, 只在io线程调用
+  bool FlushCoalesced();
+  // 尽量告知客户端原因后断开连接
+  void Kick(int reason);
 
-  void HandleWrite(const boost::system::error_code& error,
-                   std::shared_ptr<CSession> shared_self);
+  // 把队列中的多个节点合并为一次gather写, 只在socket所属的io线程调用
+  void StartWrite();
+  void HandleWrite(const boost::system::error_code& error);
 
   tcp::socket socket_;
-  std::string session_id_;
-  char data_[kMaxLength];
+  uint64_t session_id_;
+  RingBuffer recv_buf_;
+  // 接收方向的消息头版本, 只在io线程修改
+  std::atomic<int> recv_version_;
+  // 单条消息体的上限, 限制每个session接收时占用的内存
+  uint32_t max_recv_bytes_;
+  // 正在接收的大消息
+  std::shared_ptr<RecvNode> body_node_;
   CServer* server_;
   bool close_;
-  std::queue<std::shared_ptr<SendNode> > send_que_;
-  std::mutex send_lock_;
-  // 收到的消息结构
-  std::shared_ptr<RecvNode> recv_msg_node_;
-  bool head_parsed_;
-  // 收到的头部结构
-  std::shared_ptr<MsgNode> recv_head_node_;
-  int user_uid_;
+  // 所属io_context的时间轮和最近一次读到数据的tick, 只在io线程访问
+  TimingWheel* wheel_;
+  uint64_t last_active_tick_;
+  // 下线通知已入队, 发送队列写完后断开, 只在io线程访问
+  bool close_after_flush_;
+  // 所属io_context的session数, 用于按负载分配新连接
+  std::atomic<int64_t>& session_count_;
+  // 任意线程入队, io线程出队
+  MpscQueue<std::shared_ptr<SendNode> > send_que_;
+  std::atomic<int> send_que_size_;
+  // 已入队尚未写完的消息体字节数, 不超过发送预算
+  std::atomic<int64_t> send_que_bytes_;
+  // 当前写操作开始的时间(毫秒), 没有写操作时为0
+  std::atomic<int64_t> write_start_ms_;
+  // 最近写出速率的平滑值(字节/秒), 用于估算排空队列的时间
+  std::atomic<int64_t> drain_rate_;
+  // coalesce策略下暂存的通知, 每种通知只保留最新的一条
+  std::mutex coalesce_mtx_;
+  std::map<short, std::shared_ptr<SendNode> > coalesced_;
+  std::atomic<bool> has_coalesced_;
+  // 已因慢消费者被断开, 之后的消息直接丢弃
+  std::atomic<bool> kicked_;
+  // 已经投递或正在进行写操作时为true
+  std::atomic<bool> write_scheduled_;
+  // 以下成员只在io线程访问
+  // 正在写的一批节点及其缓冲区, 写完成前保持有效
+  std::vector<std::shared_ptr<SendNode> > sending_;
+  std::vector<net::const_buffer> send_bufs_;
+  // sending_中消息体的总字节数
+  int64_t sending_bytes_;
+  // 超出本批字节上限而留到下一批的节点
+  std::shared_ptr<SendNode> pending_;
+  // 发送方向的消息头版本, 在真正写出时决定
+  int send_version_;
+  // logic线程登录时写, io线程断开时读
+  std::atomic<int> user_uid_;
+  // 登录时协商的消息体编码, logic线程写, 任意线程读
+  std::atomic<int> codec_;
+  // 登录时协商的压缩, logic线程写, 任意线程读
+  std::atomic<bool> compress_;
+  // 已投递给logic尚未处理完的消息数
+  std::atomic<int> logic_pending_;
+  // 因logic积压暂停读取时为true, 把它改回false的一方负责重新发起读取
+  std::atomic<bool> read_paused_;
+  // worker队列满时暂存的一条消息, 投递成功之前不再解析之后的消息,
+  // 只在io线程访问
+  std::shared_ptr<LogicNode> blocked_msg_;
 };
 
 class LogicNode {
   friend class LogicSystem;
+  friend class LogicWorker;
 
  public:
   LogicNode(std::shared_ptr<CSession> session,
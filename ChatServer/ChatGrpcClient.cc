@@ -1,8 +1,8 @@
 #include "ChatGrpcClient.hpp"
 
 #include "ConfigManager.hpp"
-#include "MysqlManager.hpp"
-#include "RedisManager.hpp"
+#include "ProfileStore.hpp"
+#include "UserInfoCache.hpp"
 
 ChatConnectionPool::ChatConnectionPool(std::size_t size, std::string host,
                                        std::string port)
@@ -69,14 +69,16 @@ ChatGrpcClient::ChatGrpcClient() {
 AddFriendResponse ChatGrpcClient::NotifyAddFriend(
     std::string server_ip, const AddFriendRequest& request) {
   AddFriendResponse response;
+  response.set_error(ErrorCodes::Success);
+
   Defer defer([&response, &request]() {
-    response.set_error(ErrorCodes::Success);
     response.set_applyuid(request.applyuid());
     response.set_touid(request.touid());
   });
 
   auto find_iter = pools_.find(server_ip);
   if (find_iter == pools_.end()) {
+    response.set_error(ErrorCodes::RPCFailed);
     return response;
   }
 
@@ -107,6 +109,7 @@ AuthFriendResponse ChatGrpcClient::NotifyAuthFriend(
 
   auto find_iter = pools_.find(server_ip);
   if (find_iter == pools_.end()) {
+    response.set_error(ErrorCodes::RPCFailed);
     return response;
   }
 
@@ -125,56 +128,24 @@ AuthFriendResponse ChatGrpcClient::NotifyAuthFriend(
   return response;
 }
 
-bool ChatGrpcClient::GetBaseInfo(std::string base_key, int uid,
-                                 std::shared_ptr<UserInfo>& userinfo) {
-  // 优先查redis中查询用户信息
-  std::string info_str = "";
-  bool b_base = RedisManager::GetInstance()->Get(base_key, info_str);
-  if (b_base) {
-    Json::Reader reader;
-    Json::Value root;
-    reader.parse(info_str, root);
-    userinfo->uid = root["uid"].asInt();
-    userinfo->name = root["name"].asString();
-    userinfo->pwd = root["pwd"].asString();
-    userinfo->email = root["email"].asString();
-    userinfo->nick = root["nick"].asString();
-    userinfo->desc = root["desc"].asString();
-    userinfo->sex = root["sex"].asInt();
-    userinfo->icon = root["icon"].asString();
-    std::cout << "user login uid is  " << userinfo->uid << " name  is "
-              << userinfo->name << " pwd is " << userinfo->pwd << " email is "
-              << userinfo->email << std::endl;
-  } else {
-    // redis中没有则查询mysql
-    // 查询数据库
-    std::shared_ptr<UserInfo> user_info = nullptr;
-    user_info = MysqlManager::GetInstance()->GetUser(uid);
-    if (user_info == nullptr) {
-      return false;
-    }
-
-    userinfo = user_info;
-
-    // 将数据库内容写入redis缓存
-    Json::Value redis_root;
-    redis_root["uid"] = uid;
-    redis_root["pwd"] = userinfo->pwd;
-    redis_root["name"] = userinfo->name;
-    redis_root["email"] = userinfo->email;
-    redis_root["nick"] = userinfo->nick;
-    redis_root["desc"] = userinfo->desc;
-    redis_root["sex"] = userinfo->sex;
-    redis_root["icon"] = userinfo->icon;
-    RedisManager::GetInstance()->Set(base_key, redis_root.toStyledString());
+bool ChatGrpcClient::GetBaseInfo(int uid, std::shared_ptr<UserInfo>& userinfo) {
+  // 先查进程内缓存
+  auto cache = UserInfoCache::GetInstance();
+  uint64_t epoch = 0;
+  if (auto cached = cache->Get(uid, epoch)) {
+    *userinfo = *cached;
+    return true;
   }
-
+  // 再查redis和mysql
+  if (!ProfileStore::GetInstance()->Load(uid, *userinfo)) {
+    return false;
+  }
+  cache->Put(uid, *userinfo, epoch);
   return true;
 }
 
 TextChatMsgResponse ChatGrpcClient::NotifyTextChatMsg(
-    std::string server_ip, const TextChatMsgRequest& request,
-    const Json::Value& rtvalue) {
+    std::string server_ip, const TextChatMsgRequest& request) {
   TextChatMsgResponse response;
   response.set_error(ErrorCodes::Success);
 
@@ -190,6 +161,7 @@ TextChatMsgResponse ChatGrpcClient::NotifyTextChatMsg(
 
   auto find_iter = pools_.find(server_ip);
   if (find_iter == pools_.end()) {
+    response.set_error(ErrorCodes::RPCFailed);
     return response;
   }
 
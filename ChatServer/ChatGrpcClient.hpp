@@ -46,11 +46,9 @@ class ChatGrpcClient : public Singleton<ChatGrpcClient> {
                                     const AddFriendRequest& request);
   AuthFriendResponse NotifyAuthFriend(std::string server_ip,
                                       const AuthFriendRequest& request);
-  bool GetBaseInfo(std::string base_key, int uid,
-                   std::shared_ptr<UserInfo>& userinfo);
+  bool GetBaseInfo(int uid, std::shared_ptr<UserInfo>& userinfo);
   TextChatMsgResponse NotifyTextChatMsg(std::string server_ip,
-                                        const TextChatMsgRequest& request,
-                                        const Json::Value& rtvalue);
+                                        const TextChatMsgRequest& request);
 
  private:
   ChatGrpcClient();
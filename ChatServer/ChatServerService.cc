@@ -1,8 +1,9 @@
 #include "ChatServerService.hpp"
 
 #include "CSession.hpp"
-#include "MysqlManager.hpp"
-#include "RedisManager.hpp"
+#include "MsgCodec.hpp"
+#include "ProfileStore.hpp"
+#include "UserInfoCache.hpp"
 #include "UserManager.hpp"
 
 Status ChatServerService::NotifyAddFriend(ServerContext* context,
@@ -12,25 +13,37 @@ Status ChatServerService::NotifyAddFriend(ServerContext* context,
   auto touid = request->touid();
   auto session = UserManager::GetInstance()->GetSession(touid);
 
+  response->set_error(ErrorCodes::Success);
   Defer defer([request, response]() {
-    response->set_error(ErrorCodes::Success);
     response->set_applyuid(request->applyuid());
     response->set_touid(request->touid());
   });
 
+  // 用户不在本服务器, 发送方的路由已经过期, 由它重新查询
+  if (session == nullptr) {
+    response->set_error(ErrorCodes::UserOffline);
+    return Status::OK;
+  }
+
   // 在内存中则直接发送通知对方
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
-  rtvalue["applyuid"] = request->applyuid();
-  rtvalue["name"] = request->name();
-  rtvalue["desc"] = request->desc();
-  rtvalue["icon"] = request->icon();
-  rtvalue["sex"] = request->sex();
-  rtvalue["nick"] = request->nick();
-
-  std::string return_str = rtvalue.toStyledString();
-
-  session->Send(return_str, ID_NOTIFY_ADD_FRIEND_REQ);
+  if (session->GetCodec() == kCodecProtobuf) {
+    // 字段编号与chat.AddFriendNotify一致, error缺省即为Success, 直接转发
+    session->Send(
+        MsgCodec::Encode(kCodecProtobuf, *request, ID_NOTIFY_ADD_FRIEND_REQ));
+    return Status::OK;
+  }
+
+  chat::AddFriendNotify notify;
+  notify.set_error(ErrorCodes::Success);
+  notify.set_applyuid(request->applyuid());
+  notify.set_name(request->name());
+  notify.set_desc(request->desc());
+  notify.set_icon(request->icon());
+  notify.set_sex(request->sex());
+  notify.set_nick(request->nick());
+  notify.set_touid(request->touid());
+
+  MsgCodec::Send(session, notify, ID_NOTIFY_ADD_FRIEND_REQ);
   return Status::OK;
 }
 
@@ -42,38 +55,36 @@ Status ChatServerService::NotifyAuthFriend(ServerContext* context,
   auto fromuid = request->fromuid();
   auto session = UserManager::GetInstance()->GetSession(touid);
 
+  response->set_error(ErrorCodes::Success);
   Defer defer([request, response]() {
-    response->set_error(ErrorCodes::Success);
     response->set_fromuid(request->fromuid());
     response->set_touid(request->touid());
   });
 
-  // 用户不在内存中则直接返回
+  // 用户不在本服务器, 发送方的路由已经过期, 由它重新查询
   if (session == nullptr) {
+    response->set_error(ErrorCodes::UserOffline);
     return Status::OK;
   }
 
   // 在内存中则直接发送通知对方
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
-  rtvalue["fromuid"] = request->fromuid();
-  rtvalue["touid"] = request->touid();
+  chat::AuthFriendNotify notify;
+  notify.set_error(ErrorCodes::Success);
+  notify.set_fromuid(request->fromuid());
+  notify.set_touid(request->touid());
 
-  std::string base_key = kUserBaseInfo + std::to_string(fromuid);
   auto user_info = std::make_shared<UserInfo>();
-  bool b_info = GetBaseInfo(base_key, fromuid, user_info);
+  bool b_info = GetBaseInfo(fromuid, user_info);
   if (b_info) {
-    rtvalue["name"] = user_info->name;
-    rtvalue["nick"] = user_info->nick;
-    rtvalue["icon"] = user_info->icon;
-    rtvalue["sex"] = user_info->sex;
+    notify.set_name(user_info->name);
+    notify.set_nick(user_info->nick);
+    notify.set_icon(user_info->icon);
+    notify.set_sex(user_info->sex);
   } else {
-    rtvalue["error"] = ErrorCodes::UidInvalid;
+    notify.set_error(ErrorCodes::UidInvalid);
   }
 
-  std::string return_str = rtvalue.toStyledString();
-
-  session->Send(return_str, ID_NOTIFY_AUTH_FRIEND_REQ);
+  MsgCodec::Send(session, notify, ID_NOTIFY_AUTH_FRIEND_REQ);
   return Status::OK;
 }
 
@@ -85,76 +96,48 @@ Status ChatServerService::NotifyTextChatMsg(ServerContext* context,
   auto session = UserManager::GetInstance()->GetSession(touid);
   response->set_error(ErrorCodes::Success);
 
-  // 用户不在内存中则直接返回
+  // 用户不在本服务器, 发送方的路由已经过期, 由它重新查询
   if (session == nullptr) {
+    response->set_error(ErrorCodes::UserOffline);
     return Status::OK;
   }
 
   // 在内存中则直接发送通知对方
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
-  rtvalue["fromuid"] = request->fromuid();
-  rtvalue["touid"] = request->touid();
+  if (session->GetCodec() == kCodecProtobuf) {
+    // 字段编号与chat.TextChatMsg一致, 直接转发
+    session->Send(MsgCodec::Encode(kCodecProtobuf, *request,
+                                   ID_NOTIFY_TEXT_CHAT_MSG_REQ));
+    return Status::OK;
+  }
 
+  chat::TextChatMsg notify;
+  notify.set_error(ErrorCodes::Success);
+  notify.set_fromuid(request->fromuid());
+  notify.set_touid(request->touid());
   // 将聊天数据组织为数组
-  Json::Value text_array;
   for (auto& msg : request->textmsgs()) {
-    Json::Value element;
-    element["content"] = msg.msgcontent();
-    element["msgid"] = msg.msgid();
-    text_array.append(element);
+    auto* element = notify.add_text_array();
+    element->set_content(msg.msgcontent());
+    element->set_msgid(msg.msgid());
   }
-  rtvalue["text_array"] = text_array;
 
-  std::string return_str = rtvalue.toStyledString();
-
-  session->Send(return_str, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+  MsgCodec::Send(session, notify, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
   return Status::OK;
 }
 
-bool ChatServerService::GetBaseInfo(std::string base_key, int uid,
+bool ChatServerService::GetBaseInfo(int uid,
                                     std::shared_ptr<UserInfo>& userinfo) {
-  // 优先查redis中查询用户信息
-  std::string info_str = "";
-  bool b_base = RedisManager::GetInstance()->Get(base_key, info_str);
-  if (b_base) {
-    Json::Reader reader;
-    Json::Value root;
-    reader.parse(info_str, root);
-    userinfo->uid = root["uid"].asInt();
-    userinfo->name = root["name"].asString();
-    userinfo->pwd = root["pwd"].asString();
-    userinfo->email = root["email"].asString();
-    userinfo->nick = root["nick"].asString();
-    userinfo->desc = root["desc"].asString();
-    userinfo->sex = root["sex"].asInt();
-    userinfo->icon = root["icon"].asString();
-    std::cout << "user login uid is  " << userinfo->uid << " name  is "
-              << userinfo->name << " pwd is " << userinfo->pwd << " email is "
-              << userinfo->email << std::endl;
-  } else {
-    // redis中没有则查询mysql
-    // 查询数据库
-    std::shared_ptr<UserInfo> user_info = nullptr;
-    user_info = MysqlManager::GetInstance()->GetUser(uid);
-    if (user_info == nullptr) {
-      return false;
-    }
-
-    userinfo = user_info;
-
-    // 将数据库内容写入redis缓存
-    Json::Value redis_root;
-    redis_root["uid"] = uid;
-    redis_root["pwd"] = userinfo->pwd;
-    redis_root["name"] = userinfo->name;
-    redis_root["email"] = userinfo->email;
-    redis_root["nick"] = userinfo->nick;
-    redis_root["desc"] = userinfo->desc;
-    redis_root["sex"] = userinfo->sex;
-    redis_root["icon"] = userinfo->icon;
-    RedisManager::GetInstance()->Set(base_key, redis_root.toStyledString());
+  // 先查进程内缓存
+  auto cache = UserInfoCache::GetInstance();
+  uint64_t epoch = 0;
+  if (auto cached = cache->Get(uid, epoch)) {
+    *userinfo = *cached;
+    return true;
   }
-
+  // 再查redis和mysql
+  if (!ProfileStore::GetInstance()->Load(uid, *userinfo)) {
+    return false;
+  }
+  cache->Put(uid, *userinfo, epoch);
   return true;
 }
\ No newline at end of file
@@ -38,6 +38,5 @@ class ChatServerService final : public ChatService::Service {
   Status NotifyTextChatMsg(ServerContext* context,
                            const TextChatMsgRequest* request,
                            TextChatMsgResponse* response);
-  bool GetBaseInfo(std::string base_key, int uid,
-                   std::shared_ptr<UserInfo>& userinfo);
+  bool GetBaseInfo(int uid, std::shared_ptr<UserInfo>& userinfo);
 };
\ No newline at end of file
@@ -5,46 +5,77 @@
 
 class CSession;
 class LogicNode;
+class LogicWorker;
 class UserInfo;
 class ApplyInfo;
 
-using FunCallback =
-    std::function<void(std::shared_ptr<CSession>, const uint16_t& msg_id,
-                       const std::string& msg_data)>;
+// 消息处理协程. msg_data直接指向RecvNode的缓冲区, DealMsg持有LogicNode
+// 直到处理协程结束, 挂起期间也有效; 需要保留到协程之外的数据要自行拷贝
+using FunCallback = std::function<net::awaitable<void>(
+    std::shared_ptr<CSession>, uint16_t msg_id, std::string_view msg_data)>;
 
 class LogicSystem : public Singleton<LogicSystem> {
   friend class Singleton<LogicSystem>;
 
  public:
   ~LogicSystem();
-  void PostMsgToQue(std::shared_ptr<LogicNode> msg);
+  // worker队列已满时返回false, 由调用方暂存消息, 用WaitForSpace等待空位
+  bool PostMsgToQue(std::shared_ptr<LogicNode> msg);
+  // 登记到session所在worker, 队列腾出空位后回调session的OnLogicSpace
+  void WaitForSpace(std::shared_ptr<CSession> session);
+  // session所在worker积压的消息数, 用于读取背压
+  int64_t Backlog(const CSession* session) const;
+  // 注册或替换消息处理协程, 只能在投递第一条消息之前调用
+  void RegisterHandler(uint16_t msg_id, FunCallback callback);
 
  private:
   LogicSystem();
-  void DealMsg();
+  // 按session选择worker, 同一个session的消息不会被并发处理
+  std::size_t WorkerIndex(const CSession* session) const;
+  net::awaitable<void> DealMsg(std::shared_ptr<LogicNode> logic_node);
+  // 同步的redis/mysql/grpc调用放到阻塞线程池执行, 协程挂起期间
+  // logic线程继续处理其它session的消息, 恢复时回到原来的logic线程
+  template <typename F>
+  net::awaitable<std::invoke_result_t<F&>> Offload(F f) {
+    co_return co_await net::co_spawn(
+        blocking_pool_,
+        [f = std::move(f)]() mutable
+        -> net::awaitable<std::invoke_result_t<F&>> { co_return f(); },
+        net::use_awaitable);
+  }
   void RegisterCallback();
-  bool GetBaseInfo(const std::string& base_key, int uid,
-                   std::shared_ptr<UserInfo>& userinfo);
-  void LoginHandler(std::shared_ptr<CSession> session, const uint16_t& msg_id,
-                    const std::string& msg_data);
+  // 先查进程内缓存, 未命中时在阻塞线程池中从ProfileStore加载并写入缓存
+  net::awaitable<bool> LoadBaseInfo(int uid,
+                                    std::shared_ptr<UserInfo>& userinfo);
+  // 把通知投递到touid所在的服务器: 在本服务器时交给local发送, 否则在阻塞
+  // 线程池中调用remote发rpc, remote返回false表示对方不在那台服务器.
+  // 投递失败说明路由已经过期, 重新查询后位置有变化则再投递一次
+  net::awaitable<void> Deliver(
+      int touid, std::function<void(const std::shared_ptr<CSession>&)> local,
+      std::function<bool(const std::string& server)> remote);
+  net::awaitable<void> LoginHandler(std::shared_ptr<CSession> session,
+                                    uint16_t msg_id,
+                                    std::string_view msg_data);
   bool GetFriendApplyInfo(int to_uid,
                           std::vector<std::shared_ptr<ApplyInfo>>& list);
   bool GetFriendList(int self_id,
                      std::vector<std::shared_ptr<UserInfo>>& friend_list);
   void SearchInfo(std::shared_ptr<CSession> session, const short& msg_id,
                   const std::string& msg_data);
-  void AddFriendApply(std::shared_ptr<CSession> session, const short& msg_id,
-                      const std::string& msg_data);
-  void AuthFriendApply(std::shared_ptr<CSession> session, const short& msg_id,
-                       const std::string& msg_data);
-  void DealChatTextMsg(std::shared_ptr<CSession> session, const short& msg_id,
-                       const std::string& msg_data);
+  net::awaitable<void> AddFriendApply(std::shared_ptr<CSession> session,
+                                      uint16_t msg_id,
+                                      std::string_view msg_data);
+  net::awaitable<void> AuthFriendApply(std::shared_ptr<CSession> session,
+                                       uint16_t msg_id,
+                                       std::string_view msg_data);
+  net::awaitable<void> DealChatTextMsg(std::shared_ptr<CSession> session,
+                                       uint16_t msg_id,
+                                       std::string_view msg_data);
   bool IsPureDigit(const std::string& str);
 
-  std::thread worker_;
-  std::queue<std::shared_ptr<LogicNode>> msg_que_;
-  std::mutex mtx_;
-  std::condition_variable cond_;
-  std::atomic<bool> stop_;
+  // 在workers_之后析构, 保证进行中的协程都已结束
+  net::thread_pool blocking_pool_;
+  std::vector<std::unique_ptr<LogicWorker>> workers_;
+  // 启动时注册, 之后只读, 各个worker并发查找
   std::unordered_map<uint16_t, FunCallback> func_callbacks_;
 };
\ No newline at end of file
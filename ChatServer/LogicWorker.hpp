@@ -0,0 +1,62 @@
+#pragma once
+#include "MpscRing.hpp"
+#include "utilities.hpp"
+
+class CSession;
+class LogicNode;
+
+using LogicHandler =
+    std::function<net::awaitable<void>(std::shared_ptr<LogicNode>)>;
+
+// 单个logic线程, 在自己的io_context上以协程方式运行消息处理.
+// 同一个session的消息总是投递到同一个worker, 并按接收顺序逐条处理,
+// 不同session的处理协程在等待后端调用时交替执行.
+// io线程把消息放进无锁环形队列, 只在worker空闲时投递一次唤醒,
+// worker每次批量取出消息分发到各session的收件箱
+class LogicWorker {
+ public:
+  LogicWorker(std::size_t index, LogicHandler handler);
+  ~LogicWorker();
+  LogicWorker(const LogicWorker&) = delete;
+  LogicWorker& operator=(const LogicWorker&) = delete;
+
+  // 队列已满时返回false, 调用方自行暂存消息, 用WaitForSpace等待空位
+  bool Post(std::shared_ptr<LogicNode> msg);
+  // 登记等待队列空位的session, worker取出消息后回调其OnLogicSpace.
+  // 登记之前队列可能已经取空, 调用方登记后要再尝试一次Post
+  void WaitForSpace(std::shared_ptr<CSession> session);
+  // 已投递尚未开始处理的消息数, 任意线程读取
+  int64_t Depth() const;
+  // 处理完已经投递的消息后退出线程
+  void Stop();
+
+ private:
+  // 以下函数只在worker线程调用
+  void DrainRing();
+  void Enqueue(std::shared_ptr<LogicNode> msg);
+  void NotifyWaiters();
+  // 依次处理一个session收件箱中的消息, 收件箱为空时结束
+  net::awaitable<void> Drain(CSession* key);
+
+  LogicHandler handler_;
+  net::io_context ioc_;
+  net::executor_work_guard<net::io_context::executor_type> work_;
+  MpscRing<std::shared_ptr<LogicNode>> ring_;
+  // 已投递DrainRing尚未执行完, 期间生产者不再重复投递
+  std::atomic<bool> drain_scheduled_;
+  // 每个session的收件箱, 存在即表示该session有协程正在处理
+  std::unordered_map<CSession*, std::queue<std::shared_ptr<LogicNode>>>
+      inboxes_;
+  // 已投递尚未开始处理的消息数, 由Metrics定时输出
+  std::atomic<int64_t>& depth_;
+  std::atomic<int64_t>& handled_;
+  // 队列满导致投递失败的次数
+  std::atomic<int64_t>& full_;
+  // 正在处理消息的session数
+  std::atomic<int64_t>& active_;
+  // 等待队列空位的session, 每次通知后清空
+  std::mutex waiters_mtx_;
+  std::vector<std::shared_ptr<CSession>> waiters_;
+  std::atomic<bool> has_waiters_;
+  std::thread thread_;
+};
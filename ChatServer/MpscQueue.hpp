@@ -0,0 +1,67 @@
+#pragma once
+#include "BufferPool.hpp"
+#include "utilities.hpp"
+
+// 多生产者单消费者无锁队列(Vyukov), 生产者Push只做一次原子交换不会阻塞,
+// Pop只能由唯一的消费者线程调用
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() {
+    Node* stub = NewNode(T());
+    head_.store(stub, std::memory_order_relaxed);
+    tail_ = stub;
+  }
+
+  ~MpscQueue() {
+    T value;
+    while (Pop(value)) {
+    }
+    DeleteNode(tail_);
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void Push(T value) {
+    Node* node = NewNode(std::move(value));
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  // 队列为空或者有生产者尚未完成链接时返回false
+  bool Pop(T& value) {
+    Node* tail = tail_;
+    Node* next = tail->next_.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    value = std::move(next->value_);
+    tail_ = next;
+    DeleteNode(tail);
+    return true;
+  }
+
+  bool Empty() const {
+    return tail_->next_.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  struct Node {
+    explicit Node(T&& value) : next_(nullptr), value_(std::move(value)) {}
+    std::atomic<Node*> next_;
+    T value_;
+  };
+
+  static Node* NewNode(T&& value) {
+    return new (BufferPool::Allocate(sizeof(Node))) Node(std::move(value));
+  }
+
+  static void DeleteNode(Node* node) {
+    node->~Node();
+    BufferPool::Deallocate(reinterpret_cast<char*>(node), sizeof(Node));
+  }
+
+  std::atomic<Node*> head_;
+  Node* tail_;
+};
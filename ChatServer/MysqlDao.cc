@@ -251,7 +251,7 @@ bool MysqlDao::CheckPwd(const std::string& email, const std::string pwd,
 
 std::shared_ptr<UserInfo> MysqlDao::GetUser(int uid) {
   auto conn = pool_->GetConnection();
-  if (conn = nullptr) return nullptr;
+  if (conn == nullptr) return nullptr;
 
   Defer defer([this, &conn]() { pool_->ReturnConnection(std::move(conn)); });
 
@@ -284,7 +284,7 @@ std::shared_ptr<UserInfo> MysqlDao::GetUser(int uid) {
 
 std::shared_ptr<UserInfo> MysqlDao::GetUser(std::string name) {
   auto conn = pool_->GetConnection();
-  if (conn = nullptr) return nullptr;
+  if (conn == nullptr) return nullptr;
 
   Defer defer([this, &conn]() { pool_->ReturnConnection(std::move(conn)); });
 
@@ -360,8 +360,56 @@ bool MysqlDao::GetApplyList(int to_uid,
 }
 
 // 获取好友列表
-bool MysqlDao::GetFriendList(
-    int self_id, std::vector<std::shared_ptr<UserInfo>>& user_info_list) {
+bool MysqlDao::GetUsers(const std::vector<int>& uids,
+                        std::vector<std::shared_ptr<UserInfo>>& users) {
+  if (uids.empty()) {
+    return true;
+  }
+  auto conn = pool_->GetConnection();
+  if (conn == nullptr) {
+    return false;
+  }
+
+  Defer defer([this, &conn]() { pool_->ReturnConnection(std::move(conn)); });
+
+  try {
+    // 每kMaxInList个uid一条IN查询
+    for (std::size_t begin = 0; begin < uids.size(); begin += kMaxInList) {
+      std::size_t end = std::min(uids.size(), begin + kMaxInList);
+      std::string sql = "SELECT * FROM user WHERE uid IN (?";
+      for (std::size_t i = begin + 1; i < end; ++i) {
+        sql += ",?";
+      }
+      sql += ")";
+      std::unique_ptr<sql::PreparedStatement> pstmt(
+          conn->conn_->prepareStatement(sql));
+      for (std::size_t i = begin; i < end; ++i) {
+        pstmt->setInt(static_cast<int>(i - begin + 1), uids[i]);
+      }
+      std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+      while (res->next()) {
+        auto user_ptr = std::make_shared<UserInfo>();
+        user_ptr->pwd = res->getString("pwd");
+        user_ptr->email = res->getString("email");
+        user_ptr->name = res->getString("name");
+        user_ptr->nick = res->getString("nick");
+        user_ptr->desc = res->getString("desc");
+        user_ptr->sex = res->getInt("sex");
+        user_ptr->icon = res->getString("icon");
+        user_ptr->uid = res->getInt("uid");
+        users.push_back(std::move(user_ptr));
+      }
+    }
+    return true;
+  } catch (sql::SQLException& e) {
+    std::cerr << "SQLException: " << e.what();
+    std::cerr << " (MySQL error code: " << e.getErrorCode();
+    std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
+    return false;
+  }
+}
+
+bool MysqlDao::GetFriendIds(int self_id, std::vector<int>& friend_ids) {
   auto conn = pool_->GetConnection();
   if (conn == nullptr) {
     return false;
@@ -370,9 +418,8 @@ bool MysqlDao::GetFriendList(
   Defer defer([this, &conn]() { pool_->ReturnConnection(std::move(conn)); });
 
   try {
-    // 准备SQL语句, 根据起始id和限制条数返回列表
     std::unique_ptr<sql::PreparedStatement> pstmt(conn->conn_->prepareStatement(
-        "select * from friend where self_id = ? "));
+        "select friend_id from friend where self_id = ? "));
 
     pstmt->setInt(1, self_id);  // 将uid替换为你要查询的uid
 
@@ -380,16 +427,7 @@ bool MysqlDao::GetFriendList(
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
     // 遍历结果集
     while (res->next()) {
-      auto friend_id = res->getInt("friend_id");
-      auto back = res->getString("back");
-      // 再一次查询friend_id对应的信息
-      auto user_info = GetUser(friend_id);
-      if (user_info == nullptr) {
-        continue;
-      }
-
-      user_info->back = user_info->name;
-      user_info_list.push_back(user_info);
+      friend_ids.push_back(res->getInt("friend_id"));
     }
     return true;
   } catch (sql::SQLException& e) {
@@ -398,8 +436,6 @@ bool MysqlDao::GetFriendList(
     std::cerr << ", SQLState: " << e.getSQLState() << " )" << std::endl;
     return false;
   }
-
-  return true;
 }
 
 bool MysqlDao::AddFriendApply(const int& from, const int& to) {
@@ -0,0 +1,175 @@
+#pragma once
+#include <list>
+
+#include "Metrics.hpp"
+#include "utilities.hpp"
+
+// 以int为键的分片LRU缓存, 每片一把锁, 条目带过期时间, ttl为0时不过期.
+// 删除和清空会增加所在分片的版本号: 回源前用Get取得版本号, 回源后用Fill
+// 写入, 期间有过删除则放弃写入, 避免刚失效的条目被旧数据填回.
+// 计数以name为前缀输出, size为当前条目数
+template <typename V>
+class ShardedLru {
+ public:
+  ShardedLru(const std::string& name, std::size_t capacity,
+             std::chrono::seconds ttl)
+      : shard_capacity_((capacity + kShardCount - 1) / kShardCount),
+        ttl_(ttl),
+        shards_(kShardCount),
+        hits_(Metrics::GetInstance()->Counter(name + ".hits")),
+        misses_(Metrics::GetInstance()->Counter(name + ".misses")),
+        evictions_(Metrics::GetInstance()->Counter(name + ".evictions")),
+        invalidations_(
+            Metrics::GetInstance()->Counter(name + ".invalidations")),
+        size_(Metrics::GetInstance()->Counter(name + ".size")) {}
+
+  ShardedLru(const ShardedLru&) = delete;
+  ShardedLru& operator=(const ShardedLru&) = delete;
+
+  bool Enabled() const { return shard_capacity_ > 0; }
+
+  // 未命中或者已过期时返回false, epoch为该键所在分片当前的版本号
+  bool Get(int key, V& value, uint64_t& epoch) {
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    epoch = shard.epoch_;
+    auto it = shard.index_.find(key);
+    if (it == shard.index_.end()) {
+      misses_++;
+      return false;
+    }
+    if (ttl_.count() > 0 &&
+        it->second->expire_ <= std::chrono::steady_clock::now()) {
+      shard.lru_.erase(it->second);
+      shard.index_.erase(it);
+      size_--;
+      misses_++;
+      return false;
+    }
+    shard.lru_.splice(shard.lru_.begin(), shard.lru_, it->second);
+    value = it->second->value_;
+    hits_++;
+    return true;
+  }
+
+  // 不查找, 只取版本号
+  uint64_t Epoch(int key) {
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    return shard.epoch_;
+  }
+
+  // 回源得到的值, 版本号变化时放弃
+  void Fill(int key, V value, uint64_t epoch) {
+    if (!Enabled()) {
+      return;
+    }
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    if (shard.epoch_ != epoch) {
+      return;
+    }
+    Insert(shard, key, std::move(value));
+  }
+
+  // 确定的新值, 直接覆盖并使进行中的回源作废
+  void Set(int key, V value) {
+    if (!Enabled()) {
+      return;
+    }
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    ++shard.epoch_;
+    Insert(shard, key, std::move(value));
+  }
+
+  void Erase(int key) {
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    EraseLocked(shard, key, nullptr);
+  }
+
+  // 当前值等于expected时才删除
+  void EraseIf(int key, const V& expected) {
+    auto& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    EraseLocked(shard, key, &expected);
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mtx_);
+      ++shard.epoch_;
+      size_ -= static_cast<int64_t>(shard.lru_.size());
+      shard.lru_.clear();
+      shard.index_.clear();
+    }
+  }
+
+ private:
+  static const std::size_t kShardCount = 16;
+
+  struct Entry {
+    int key_;
+    V value_;
+    std::chrono::steady_clock::time_point expire_;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx_;
+    // 表头为最近使用
+    std::list<Entry> lru_;
+    std::unordered_map<int, typename std::list<Entry>::iterator> index_;
+    uint64_t epoch_ = 0;
+  };
+
+  Shard& ShardOf(int key) {
+    return shards_[static_cast<uint32_t>(key) % kShardCount];
+  }
+
+  void Insert(Shard& shard, int key, V value) {
+    auto expire = std::chrono::steady_clock::now() + ttl_;
+    auto it = shard.index_.find(key);
+    if (it != shard.index_.end()) {
+      it->second->value_ = std::move(value);
+      it->second->expire_ = expire;
+      shard.lru_.splice(shard.lru_.begin(), shard.lru_, it->second);
+      return;
+    }
+    shard.lru_.push_front(Entry{key, std::move(value), expire});
+    shard.index_[key] = shard.lru_.begin();
+    size_++;
+    if (shard.lru_.size() > shard_capacity_) {
+      shard.index_.erase(shard.lru_.back().key_);
+      shard.lru_.pop_back();
+      size_--;
+      evictions_++;
+    }
+  }
+
+  void EraseLocked(Shard& shard, int key, const V* expected) {
+    auto it = shard.index_.find(key);
+    if (it == shard.index_.end()) {
+      // 可能有进行中的回源
+      ++shard.epoch_;
+      return;
+    }
+    if (expected != nullptr && !(it->second->value_ == *expected)) {
+      return;
+    }
+    ++shard.epoch_;
+    invalidations_++;
+    shard.lru_.erase(it->second);
+    shard.index_.erase(it);
+    size_--;
+  }
+
+  std::size_t shard_capacity_;
+  std::chrono::seconds ttl_;
+  std::vector<Shard> shards_;
+  std::atomic<int64_t>& hits_;
+  std::atomic<int64_t>& misses_;
+  std::atomic<int64_t>& evictions_;
+  std::atomic<int64_t>& invalidations_;
+  std::atomic<int64_t>& size_;
+};
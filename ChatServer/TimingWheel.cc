@@ -0,0 +1,62 @@
+#include "TimingWheel.hpp"
+
+#include "CSession.hpp"
+#include "Metrics.hpp"
+
+TimingWheel::TimingWheel(net::io_context& ioc, int tick_ms,
+                         uint64_t timeout_ticks)
+    : timer_(ioc),
+      tick_ms_(tick_ms),
+      timeout_ticks_(timeout_ticks),
+      tick_(0),
+      slots_(timeout_ticks + 1) {}
+
+TimingWheel::~TimingWheel() {}
+
+void TimingWheel::Start() {
+  if (timeout_ticks_ == 0) {
+    return;
+  }
+  timer_.expires_after(std::chrono::milliseconds(tick_ms_));
+  timer_.async_wait([this](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    OnTick();
+    Start();
+  });
+}
+
+void TimingWheel::Add(const std::shared_ptr<CSession>& session) {
+  if (timeout_ticks_ == 0) {
+    return;
+  }
+  slots_[(tick_ + timeout_ticks_) % slots_.size()].push_back(session);
+}
+
+uint64_t TimingWheel::Now() const { return tick_; }
+
+void TimingWheel::OnTick() {
+  static auto& idle_closed =
+      Metrics::GetInstance()->Counter("session.idle_closed");
+
+  ++tick_;
+  std::vector<std::weak_ptr<CSession>> expired;
+  expired.swap(slots_[tick_ % slots_.size()]);
+  for (auto& entry : expired) {
+    auto session = entry.lock();
+    if (session == nullptr || session->IsClosed()) {
+      continue;
+    }
+    // 因logic积压暂停读取的session收不到心跳, 不算空闲
+    uint64_t deadline = session->IsReadPaused()
+                            ? tick_ + timeout_ticks_
+                            : session->LastActiveTick() + timeout_ticks_;
+    if (deadline > tick_) {
+      slots_[deadline % slots_.size()].push_back(std::move(entry));
+      continue;
+    }
+    idle_closed++;
+    session->CloseIdle();
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "utilities.hpp"
+
+class CSession;
+
+// 每个io_context一个的哈希时间轮, 用于回收空闲session, 只在所属io线程访问.
+// 所有session共用一个定时器, 每个tick处理一个槽位: 期间有过读取的session
+// 按最后活动的tick重新放入对应槽位, 超时的关闭. 收到数据时session只记录
+// 当前tick, 不移动槽位, 刷新和回收都是O(1)
+class TimingWheel {
+ public:
+  // timeout_ticks为0时不回收, Add直接忽略
+  TimingWheel(net::io_context& ioc, int tick_ms, uint64_t timeout_ticks);
+  ~TimingWheel();
+  TimingWheel(const TimingWheel&) = delete;
+  TimingWheel& operator=(const TimingWheel&) = delete;
+
+  void Start();
+  void Add(const std::shared_ptr<CSession>& session);
+  uint64_t Now() const;
+
+ private:
+  void OnTick();
+
+  net::steady_timer timer_;
+  int tick_ms_;
+  uint64_t timeout_ticks_;
+  uint64_t tick_;
+  // 槽位数为timeout_ticks_ + 1, 任何截止tick都落在当前tick之后一圈以内
+  std::vector<std::vector<std::weak_ptr<CSession>>> slots_;
+};
@@ -1,23 +1,85 @@
 #include "UserManager.hpp"
 
-UserManager::~UserManager() { uid_to_session_.clear(); }
+UserManager::UserManager() : chunks_(new std::atomic<Chunk*>[kMaxChunks]) {
+  for (int i = 0; i < kMaxChunks; ++i) {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+UserManager::~UserManager() {
+  for (int i = 0; i < kMaxChunks; ++i) {
+    delete chunks_[i].load(std::memory_order_relaxed);
+  }
+}
 
 std::shared_ptr<CSession> UserManager::GetSession(int uid) {
-  std::lock_guard<std::mutex> lock(mtx_);
-  auto it = uid_to_session_.find(uid);
-  if (it == uid_to_session_.end()) {
+  auto* slot = FindSlot(uid, false);
+  auto& stripe = StripeOf(uid);
+  std::lock_guard<std::mutex> lock(stripe.mtx_);
+  if (slot != nullptr) {
+    return *slot;
+  }
+  auto it = stripe.overflow_.find(uid);
+  if (it == stripe.overflow_.end()) {
     return nullptr;
   }
   return it->second;
 }
 
 void UserManager::SetUserSession(int uid, std::shared_ptr<CSession> session) {
-  std::lock_guard<std::mutex> lock(mtx_);
-  uid_to_session_[uid] = session;
+  auto* slot = FindSlot(uid, true);
+  auto& stripe = StripeOf(uid);
+  std::lock_guard<std::mutex> lock(stripe.mtx_);
+  if (slot != nullptr) {
+    *slot = std::move(session);
+    return;
+  }
+  stripe.overflow_[uid] = std::move(session);
 }
 
-void UserManager::RemoveUserSession(int uid) {
-  auto uid_str = std::to_string(uid);
-  std::lock_guard<std::mutex> lock(mtx_);
-  uid_to_session_.erase(uid);
-}
\ No newline at end of file
+bool UserManager::RemoveUserSession(int uid,
+                                    const std::shared_ptr<CSession>& session) {
+  auto* slot = FindSlot(uid, false);
+  auto& stripe = StripeOf(uid);
+  // 移出的session在锁外释放
+  std::shared_ptr<CSession> removed;
+  std::lock_guard<std::mutex> lock(stripe.mtx_);
+  if (slot != nullptr) {
+    if (*slot == session) {
+      removed.swap(*slot);
+    }
+    return removed != nullptr;
+  }
+  auto it = stripe.overflow_.find(uid);
+  if (it != stripe.overflow_.end() && it->second == session) {
+    removed.swap(it->second);
+    stripe.overflow_.erase(it);
+  }
+  return removed != nullptr;
+}
+
+std::shared_ptr<CSession>* UserManager::FindSlot(int uid, bool create) {
+  if (uid < 0 || uid >= kMaxChunks * kChunkSize) {
+    return nullptr;
+  }
+  auto& entry = chunks_[uid >> kChunkBits];
+  Chunk* chunk = entry.load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    if (!create) {
+      return nullptr;
+    }
+    // 多个线程同时分配同一个块时只保留一个
+    auto* fresh = new Chunk();
+    if (entry.compare_exchange_strong(chunk, fresh,
+                                      std::memory_order_acq_rel)) {
+      chunk = fresh;
+    } else {
+      delete fresh;
+    }
+  }
+  return &chunk->slots_[uid & (kChunkSize - 1)];
+}
+
+UserManager::Stripe& UserManager::StripeOf(int uid) {
+  return stripes_[static_cast<unsigned>(uid) % kStripeCount];
+}
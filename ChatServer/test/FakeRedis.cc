@@ -0,0 +1,203 @@
+#include "FakeRedis.hpp"
+
+FakeRedis::FakeRedis(uint16_t port)
+    : acceptor_(ioc_, tcp::endpoint(net::ip::address_v4::loopback(), port)),
+      fail_every_(0),
+      connections_(0),
+      peak_(0),
+      commands_(0) {
+  net::co_spawn(ioc_, Accept(), net::detached);
+  thread_ = std::thread([this]() { ioc_.run(); });
+}
+
+FakeRedis::~FakeRedis() {
+  ioc_.stop();
+  thread_.join();
+}
+
+void FakeRedis::SetFailEvery(int64_t n) { fail_every_ = n; }
+
+int64_t FakeRedis::Connections() const { return connections_; }
+
+int64_t FakeRedis::PeakConnections() const { return peak_; }
+
+int64_t FakeRedis::Commands() const { return commands_; }
+
+net::awaitable<void> FakeRedis::Accept() {
+  while (true) {
+    boost::system::error_code ec;
+    auto socket = co_await acceptor_.async_accept(
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      co_return;
+    }
+    int64_t count = ++connections_;
+    int64_t peak = peak_;
+    while (count > peak && !peak_.compare_exchange_weak(peak, count)) {
+    }
+    net::co_spawn(ioc_, Serve(std::move(socket)), net::detached);
+  }
+}
+
+net::awaitable<void> FakeRedis::Serve(tcp::socket socket) {
+  std::string buf;
+  std::vector<std::string> args;
+  while (co_await ReadCommand(socket, buf, args)) {
+    int64_t fail_every = fail_every_;
+    if (++commands_ % std::max<int64_t>(fail_every, 1) == 0 &&
+        fail_every > 0) {
+      break;
+    }
+    auto reply = Execute(args);
+    boost::system::error_code ec;
+    co_await net::async_write(socket, net::buffer(reply),
+                              net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      break;
+    }
+  }
+  // 先减计数再关闭, 客户端看到断开时计数已经更新
+  connections_--;
+  boost::system::error_code ec;
+  socket.close(ec);
+}
+
+net::awaitable<bool> FakeRedis::ReadCommand(tcp::socket& socket,
+                                            std::string& buf,
+                                            std::vector<std::string>& args) {
+  boost::system::error_code ec;
+  // 读取一行, 不含\r\n
+  auto read_line = [&](std::string& line) -> net::awaitable<bool> {
+    auto n = co_await net::async_read_until(
+        socket, net::dynamic_buffer(buf), "\r\n",
+        net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      co_return false;
+    }
+    line.assign(buf, 0, n - 2);
+    buf.erase(0, n);
+    co_return true;
+  };
+
+  args.clear();
+  std::string line;
+  if (!co_await read_line(line) || line.empty() || line[0] != '*') {
+    co_return false;
+  }
+  int count = std::stoi(line.substr(1));
+  for (int i = 0; i < count; ++i) {
+    if (!co_await read_line(line) || line.empty() || line[0] != '$') {
+      co_return false;
+    }
+    std::size_t len = std::stoul(line.substr(1));
+    if (buf.size() < len + 2) {
+      co_await net::async_read(socket, net::dynamic_buffer(buf),
+                               net::transfer_at_least(len + 2 - buf.size()),
+                               net::redirect_error(net::use_awaitable, ec));
+      if (ec) {
+        co_return false;
+      }
+    }
+    args.emplace_back(buf, 0, len);
+    buf.erase(0, len + 2);
+  }
+  co_return !args.empty();
+}
+
+std::string FakeRedis::Bulk(const std::string* value) {
+  if (value == nullptr) {
+    return "$-1\r\n";
+  }
+  return "$" + std::to_string(value->size()) + "\r\n" + *value + "\r\n";
+}
+
+std::string FakeRedis::Integer(int64_t value) {
+  return ":" + std::to_string(value) + "\r\n";
+}
+
+std::string FakeRedis::Execute(std::vector<std::string>& args) {
+  auto& cmd = args[0];
+  std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
+  auto find = [](auto& map, const std::string& key) {
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : &it->second;
+  };
+  if (cmd == "PING") {
+    return "+PONG\r\n";
+  }
+  if (cmd == "AUTH") {
+    return "+OK\r\n";
+  }
+  if (cmd == "GET" && args.size() == 2) {
+    return Bulk(find(strings_, args[1]));
+  }
+  if (cmd == "SET" && args.size() >= 3) {
+    strings_[args[1]] = args[2];
+    return "+OK\r\n";
+  }
+  if (cmd == "SETEX" && args.size() == 4) {
+    strings_[args[1]] = args[3];
+    return "+OK\r\n";
+  }
+  if (cmd == "MGET") {
+    std::string reply = "*" + std::to_string(args.size() - 1) + "\r\n";
+    for (std::size_t i = 1; i < args.size(); ++i) {
+      reply += Bulk(find(strings_, args[i]));
+    }
+    return reply;
+  }
+  if (cmd == "DEL") {
+    int64_t count = 0;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+      count += strings_.erase(args[i]) + hashes_.erase(args[i]) +
+               lists_.erase(args[i]);
+    }
+    return Integer(count);
+  }
+  if (cmd == "EXISTS" && args.size() == 2) {
+    return Integer(strings_.count(args[1]) + hashes_.count(args[1]) +
+                   lists_.count(args[1]));
+  }
+  if (cmd == "HSET" && args.size() == 4) {
+    bool added = hashes_[args[1]].insert_or_assign(args[2], args[3]).second;
+    return Integer(added ? 1 : 0);
+  }
+  if (cmd == "HGET" && args.size() == 3) {
+    auto* hash = find(hashes_, args[1]);
+    return Bulk(hash == nullptr ? nullptr : find(*hash, args[2]));
+  }
+  if (cmd == "HDEL" && args.size() == 3) {
+    auto* hash = find(hashes_, args[1]);
+    return Integer(hash == nullptr ? 0 : hash->erase(args[2]));
+  }
+  if (cmd == "HINCRBY" && args.size() == 4) {
+    auto& field = hashes_[args[1]][args[2]];
+    int64_t value = (field.empty() ? 0 : std::stoll(field)) +
+                    std::stoll(args[3]);
+    field = std::to_string(value);
+    return Integer(value);
+  }
+  if ((cmd == "LPUSH" || cmd == "RPUSH") && args.size() == 3) {
+    auto& list = lists_[args[1]];
+    if (cmd == "LPUSH") {
+      list.push_front(args[2]);
+    } else {
+      list.push_back(args[2]);
+    }
+    return Integer(list.size());
+  }
+  if ((cmd == "LPOP" || cmd == "RPOP") && args.size() == 2) {
+    auto* list = find(lists_, args[1]);
+    if (list == nullptr || list->empty()) {
+      return Bulk(nullptr);
+    }
+    std::string value = cmd == "LPOP" ? list->front() : list->back();
+    if (cmd == "LPOP") {
+      list->pop_front();
+    } else {
+      list->pop_back();
+    }
+    return Bulk(&value);
+  }
+  return "-ERR unknown command '" + cmd + "'\r\n";
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "utilities.hpp"
+
+// 测试和基准程序使用的内存redis, 只实现RedisManager用到的命令, 忽略过期时间.
+// 在自己的线程上运行, 可以每隔若干条命令主动断开连接, 模拟连接出错
+class FakeRedis {
+ public:
+  explicit FakeRedis(uint16_t port);
+  ~FakeRedis();
+  FakeRedis(const FakeRedis&) = delete;
+  FakeRedis& operator=(const FakeRedis&) = delete;
+
+  // 每收到n条命令断开一次当前连接, 不回复该命令; 0表示不断开
+  void SetFailEvery(int64_t n);
+  int64_t Connections() const;
+  // 同时打开的连接数的最大值
+  int64_t PeakConnections() const;
+  int64_t Commands() const;
+
+ private:
+  net::awaitable<void> Accept();
+  net::awaitable<void> Serve(tcp::socket socket);
+  // 读取一条RESP数组形式的命令, 连接断开时返回false
+  net::awaitable<bool> ReadCommand(tcp::socket& socket, std::string& buf,
+                                   std::vector<std::string>& args);
+  // 以下函数只在redis线程调用
+  std::string Execute(std::vector<std::string>& args);
+  static std::string Bulk(const std::string* value);
+  static std::string Integer(int64_t value);
+
+  net::io_context ioc_;
+  tcp::acceptor acceptor_;
+  std::unordered_map<std::string, std::string> strings_;
+  std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
+      hashes_;
+  std::unordered_map<std::string, std::deque<std::string>> lists_;
+  std::atomic<int64_t> fail_every_;
+  std::atomic<int64_t> connections_;
+  std::atomic<int64_t> peak_;
+  std::atomic<int64_t> commands_;
+  std::thread thread_;
+};
@@ -0,0 +1,132 @@
+#include <google/protobuf/util/json_util.h>
+
+#include "JsonWriter.hpp"
+#include "chat.pb.h"
+
+// json序列化的基准: 带20个好友的登录回包, 比较Json::Value的
+// toStyledString和JsonWriter, 以及protobuf的MessageToJsonString和
+// JsonWriter的反射版本. 反射版本的输出要与MessageToJsonString逐字节相同.
+// 用法: json_writer_bench [循环次数]
+namespace {
+const int kDefaultIterations = 20000;
+const int kFriendCount = 20;
+
+chat::LoginRsp MakeLoginRsp() {
+  chat::LoginRsp rsp;
+  rsp.set_error(0);
+  rsp.set_uid(1001);
+  rsp.set_pwd("e10adc3949ba59abbe56e057f20f883e");
+  rsp.set_name("llfc");
+  rsp.set_email("llfc@example.com");
+  rsp.set_nick("恋恋风辰");
+  rsp.set_desc("写代码的\"人\"\n");
+  rsp.set_sex(1);
+  rsp.set_icon(":/res/head_1.jpg");
+  for (int i = 0; i < kFriendCount; ++i) {
+    auto* user = rsp.add_friend_list();
+    user->set_uid(2000 + i);
+    user->set_name("friend_" + std::to_string(i));
+    user->set_desc("这是好友" + std::to_string(i) + "的签名");
+    user->set_icon(":/res/head_" + std::to_string(i % 5) + ".jpg");
+    user->set_nick("nick_" + std::to_string(i));
+    user->set_sex(i % 2);
+    user->set_back("备注" + std::to_string(i));
+  }
+  return rsp;
+}
+
+// 与改为protobuf之前登录回包的json结构相同
+Json::Value MakeLoginJson(const chat::LoginRsp& rsp) {
+  Json::Value root;
+  root["error"] = rsp.error();
+  root["uid"] = rsp.uid();
+  root["pwd"] = rsp.pwd();
+  root["name"] = rsp.name();
+  root["email"] = rsp.email();
+  root["nick"] = rsp.nick();
+  root["desc"] = rsp.desc();
+  root["sex"] = rsp.sex();
+  root["icon"] = rsp.icon();
+  for (const auto& user : rsp.friend_list()) {
+    Json::Value obj;
+    obj["uid"] = user.uid();
+    obj["name"] = user.name();
+    obj["desc"] = user.desc();
+    obj["icon"] = user.icon();
+    obj["nick"] = user.nick();
+    obj["sex"] = user.sex();
+    obj["back"] = user.back();
+    root["friend_list"].append(obj);
+  }
+  return root;
+}
+
+// 返回每次调用的平均耗时(微秒), size为最后一次输出的字节数
+template <typename F>
+double Measure(int iterations, F serialize, std::size_t& size) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    size = serialize();
+  }
+  auto elapsed = std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - start);
+  return elapsed.count() / iterations;
+}
+
+void Report(const char* name, double us, std::size_t size) {
+  std::cout << name << ": " << size << " B, " << us << " us" << std::endl;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : kDefaultIterations;
+  auto rsp = MakeLoginRsp();
+  auto root = MakeLoginJson(rsp);
+  google::protobuf::util::JsonPrintOptions options;
+  options.always_print_primitive_fields = true;
+  options.preserve_proto_field_names = true;
+  std::string buf;
+  std::size_t size = 0;
+
+  double us = Measure(
+      iterations, [&]() { return root.toStyledString().size(); }, size);
+  Report("toStyledString", us, size);
+  us = Measure(
+      iterations,
+      [&]() {
+        buf.clear();
+        JsonWriter::Write(root, buf);
+        return buf.size();
+      },
+      size);
+  Report("JsonWriter", us, size);
+  us = Measure(
+      iterations,
+      [&]() {
+        buf.clear();
+        google::protobuf::util::MessageToJsonString(rsp, &buf, options);
+        return buf.size();
+      },
+      size);
+  Report("MessageToJsonString", us, size);
+  std::string expected = buf;
+  us = Measure(
+      iterations,
+      [&]() {
+        buf.clear();
+        JsonWriter::Write(rsp, buf);
+        return buf.size();
+      },
+      size);
+  Report("JsonWriter reflection", us, size);
+
+  if (buf != expected) {
+    std::cout << "FAILED: reflection output differs from MessageToJsonString"
+              << std::endl
+              << expected << std::endl
+              << buf << std::endl;
+    return 1;
+  }
+  std::cout << "reflection output is identical" << std::endl;
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "MpscRing.hpp"
+
+// logic入口的基准: 多个io线程向一个logic线程投递消息, 比较LogicWorker的
+// 环形队列加按需唤醒, 和每条消息一次net::post. 消息与实际一样是shared_ptr,
+// 消费者只计数, 测到的是投递本身的开销. 队列满时生产者让出cpu后重试.
+// 用法: logic_ingress_bench [生产者数] [每个生产者的消息数]
+namespace {
+const int kDefaultProducers = 4;
+const int64_t kDefaultMessages = 2000000;
+// 与LogicWorker相同的容量和每批取出的个数
+const std::size_t kRingCapacity = kMaxRecvQue;
+const std::size_t kDrainBatch = 64;
+
+using Message = std::shared_ptr<int64_t>;
+
+// LogicWorker入口部分的副本, 去掉了session收件箱和等待队列
+class RingIngress {
+ public:
+  RingIngress() : ring_(kRingCapacity), drain_scheduled_(false), consumed_(0) {}
+
+  void Post(net::io_context& ioc, Message msg) {
+    while (!ring_.TryPush(std::move(msg))) {
+      std::this_thread::yield();
+    }
+    if (!drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      net::post(ioc, [this, &ioc]() { DrainRing(ioc); });
+    }
+  }
+
+  int64_t Consumed() const { return consumed_; }
+
+ private:
+  void DrainRing(net::io_context& ioc) {
+    Message batch[kDrainBatch];
+    std::size_t count = ring_.PopBatch(batch, kDrainBatch);
+    for (std::size_t i = 0; i < count; ++i) {
+      consumed_ += *batch[i] > 0 ? 1 : 0;
+    }
+    if (count == kDrainBatch) {
+      net::post(ioc, [this, &ioc]() { DrainRing(ioc); });
+      return;
+    }
+    drain_scheduled_.exchange(false, std::memory_order_acq_rel);
+    if (ring_.Empty() ||
+        drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    net::post(ioc, [this, &ioc]() { DrainRing(ioc); });
+  }
+
+  MpscRing<Message> ring_;
+  std::atomic<bool> drain_scheduled_;
+  // 只在消费者线程写
+  int64_t consumed_;
+};
+
+// 启动消费者线程和producers个生产者, 全部消息处理完后返回每秒消息数.
+// post由生产者线程调用, 把一条消息交给消费者的io_context
+template <typename F>
+double Run(int producers, int64_t messages, net::io_context& ioc, F post) {
+  auto work = net::make_work_guard(ioc);
+  std::thread consumer([&ioc]() { ioc.run(); });
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&post, messages]() {
+      for (int64_t i = 0; i < messages; ++i) {
+        post(std::make_shared<int64_t>(i + 1));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // 不再保持io_context, 剩余的消息处理完后run返回
+  work.reset();
+  consumer.join();
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return producers * messages / elapsed;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int producers = argc > 1 ? std::stoi(argv[1]) : kDefaultProducers;
+  int64_t messages = argc > 2 ? std::stoll(argv[2]) : kDefaultMessages;
+  int64_t total = producers * messages;
+  std::cout << "producers " << producers << ", messages " << total
+            << std::endl;
+
+  net::io_context ring_ioc;
+  RingIngress ingress;
+  double ring_rate =
+      Run(producers, messages, ring_ioc,
+          [&](Message msg) { ingress.Post(ring_ioc, std::move(msg)); });
+
+  net::io_context post_ioc;
+  int64_t posted = 0;
+  double post_rate =
+      Run(producers, messages, post_ioc, [&](Message msg) {
+        net::post(post_ioc, [&posted, msg = std::move(msg)]() {
+          posted += *msg > 0 ? 1 : 0;
+        });
+      });
+
+  std::cout << "ring + wakeup: " << static_cast<int64_t>(ring_rate)
+            << " msg/s" << std::endl;
+  std::cout << "post per message: " << static_cast<int64_t>(post_rate)
+            << " msg/s" << std::endl;
+  if (ingress.Consumed() != total || posted != total) {
+    std::cout << "FAILED: consumed " << ingress.Consumed() << " and "
+              << posted << " of " << total << std::endl;
+    return 1;
+  }
+  return 0;
+}
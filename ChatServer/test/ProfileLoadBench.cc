@@ -0,0 +1,88 @@
+#include "ConfigManager.hpp"
+#include "FakeRedis.hpp"
+#include "ProfileStore.hpp"
+#include "RedisManager.hpp"
+
+// 好友资料批量加载的基准: 资料全部在redis中, 比较逐个uid调用Load(每个一次
+// GET)和一次LoadBatch(一次MGET). 默认在[Redis] Port上启动内存redis,
+// 第二个参数为external时改用该地址上已经运行的redis, 结果更接近线上.
+// 用法: profile_load_bench [每种规模的轮数] [external]
+namespace {
+const int kDefaultRounds = 200;
+const int kFirstUid = 100000;
+const int kBatchSizes[] = {50, 200, 1000};
+
+UserInfo MakeUser(int uid) {
+  UserInfo info;
+  info.uid = uid;
+  info.name = "user_" + std::to_string(uid);
+  info.pwd = "e10adc3949ba59abbe56e057f20f883e";
+  info.email = info.name + "@example.com";
+  info.nick = "nick_" + std::to_string(uid);
+  info.desc = "这是用户" + std::to_string(uid) + "的签名";
+  info.sex = uid % 2;
+  info.icon = ":/res/head_" + std::to_string(uid % 5) + ".jpg";
+  return info;
+}
+
+// 返回每轮的平均耗时(毫秒)
+template <typename F>
+double Measure(int rounds, F load) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    load();
+  }
+  auto elapsed = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start);
+  return elapsed.count() / rounds;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int rounds = argc > 1 ? std::stoi(argv[1]) : kDefaultRounds;
+  bool external = argc > 2 && std::string(argv[2]) == "external";
+  auto& cfg = ConfigManager::GetInstance();
+  auto port = static_cast<uint16_t>(std::stoi(cfg["Redis"]["Port"]));
+  std::unique_ptr<FakeRedis> fake;
+  if (!external) {
+    fake = std::make_unique<FakeRedis>(port);
+  }
+
+  // 资料预先写入redis, 测量时全部命中, 不访问数据库
+  auto redis = RedisManager::GetInstance();
+  auto store = ProfileStore::GetInstance();
+  int max_batch = *std::max_element(std::begin(kBatchSizes),
+                                    std::end(kBatchSizes));
+  for (int uid = kFirstUid; uid < kFirstUid + max_batch; ++uid) {
+    redis->SetEx(kUserBaseInfo + std::to_string(uid),
+                 ProfileStore::Encode(MakeUser(uid)), 3600);
+  }
+
+  int64_t misses = 0;
+  for (int size : kBatchSizes) {
+    std::vector<int> uids;
+    for (int uid = kFirstUid; uid < kFirstUid + size; ++uid) {
+      uids.push_back(uid);
+    }
+    double get_ms = Measure(rounds, [&]() {
+      UserInfo info;
+      for (int uid : uids) {
+        misses += store->Load(uid, info) ? 0 : 1;
+      }
+    });
+    std::vector<std::shared_ptr<UserInfo>> infos;
+    double mget_ms = Measure(rounds, [&]() {
+      store->LoadBatch(uids, infos);
+      for (auto& info : infos) {
+        misses += info == nullptr ? 1 : 0;
+      }
+    });
+    std::cout << size << " profiles: GET loop " << get_ms << " ms, MGET "
+              << mget_ms << " ms" << std::endl;
+  }
+  if (misses != 0) {
+    std::cout << "FAILED: " << misses << " profiles not loaded" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include "ConfigManager.hpp"
+#include "FakeRedis.hpp"
+#include "Metrics.hpp"
+#include "RedisManager.hpp"
+
+// 连接池的浸泡测试: 多个线程持续执行命令, 期间redis定期断开连接.
+// 结束后借出的连接数要回到0, 打开的连接数不超过PoolSize; 连接全部借出时
+// Acquire要在AcquireTimeoutMs之后返回空的lease, 而不是一直等待.
+// 命令总数可以由第一个参数指定
+namespace {
+const int kThreads = 8;
+const int64_t kDefaultCommands = 400000;
+// 平均每个连接执行这么多条命令后被redis断开一次
+const int64_t kFailEvery = 20000;
+
+// 每个线程执行的命令混合, 返回执行失败的次数
+int64_t RunCommands(int thread, int64_t count) {
+  auto redis = RedisManager::GetInstance();
+  int64_t failures = 0;
+  std::string key = "soak_" + std::to_string(thread);
+  std::string value;
+  std::vector<std::optional<std::string>> values;
+  for (int64_t i = 0; i < count; ++i) {
+    bool ok = true;
+    switch (i % 5) {
+      case 0:
+        ok = redis->Set(key, std::to_string(i));
+        break;
+      case 1:
+        ok = redis->Get(key, value);
+        break;
+      case 2:
+        ok = redis->HSet("soak_hash", key, std::to_string(i));
+        break;
+      case 3:
+        ok = redis->HIncrBy("soak_count", key, 1);
+        break;
+      default:
+        ok = redis->MGet({key, "soak_missing"}, values);
+        break;
+    }
+    failures += ok ? 0 : 1;
+  }
+  return failures;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  auto& cfg = ConfigManager::GetInstance();
+  auto port = static_cast<uint16_t>(std::stoi(cfg["Redis"]["Port"]));
+  auto pool_size = std::stoll(cfg["Redis"]["PoolSize"]);
+  auto timeout_ms = std::stoi(cfg["Redis"]["AcquireTimeoutMs"]);
+  int64_t commands = argc > 1 ? std::stoll(argv[1]) : kDefaultCommands;
+  auto& in_use = Metrics::GetInstance()->Counter("redis.pool.in_use");
+  auto& reconnects = Metrics::GetInstance()->Counter("redis.pool.reconnects");
+  auto& timeouts =
+      Metrics::GetInstance()->Counter("redis.pool.acquire_timeouts");
+
+  FakeRedis redis(port);
+  redis.SetFailEvery(kFailEvery);
+  RedisManager::GetInstance();
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<int64_t> failures(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([i, commands, &failures]() {
+      failures += RunCommands(i, commands / kThreads);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  std::cout << "commands " << commands << " in " << elapsed_ms << "ms, failed "
+            << failures << ", peak connections " << redis.PeakConnections()
+            << ", reconnects " << reconnects << ", in_use " << in_use
+            << std::endl;
+
+  bool passed = true;
+  if (in_use != 0) {
+    std::cout << "FAILED: leases not returned, in_use " << in_use
+              << std::endl;
+    passed = false;
+  }
+  if (redis.PeakConnections() > pool_size) {
+    std::cout << "FAILED: pool opened more than " << pool_size
+              << " connections" << std::endl;
+    passed = false;
+  }
+  // 断开的连接在归还时重建, 只有被断开的那条命令失败
+  if (reconnects == 0 || failures > reconnects) {
+    std::cout << "FAILED: broken connections were not replaced" << std::endl;
+    passed = false;
+  }
+
+  // 借出全部连接后再借一次, 应当按时超时返回
+  RedisConnectPool pool(2, "127.0.0.1", std::to_string(port), "",
+                        timeout_ms);
+  auto first = pool.Acquire();
+  auto second = pool.Acquire();
+  int64_t timeouts_before = timeouts;
+  auto wait_start = std::chrono::steady_clock::now();
+  auto third = std::async(std::launch::async, [&pool]() {
+    return static_cast<bool>(pool.Acquire());
+  });
+  if (third.wait_for(std::chrono::milliseconds(timeout_ms * 10)) !=
+      std::future_status::ready) {
+    std::cout << "FAILED: Acquire hangs when the pool is exhausted"
+              << std::endl;
+    // 归还连接让等待的Acquire返回, 否则无法退出
+    first.Release();
+    third.wait();
+    return 1;
+  }
+  auto waited_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - wait_start)
+                       .count();
+  std::cout << "exhausted pool acquire returned after " << waited_ms << "ms"
+            << std::endl;
+  if (!first || !second || third.get() || timeouts != timeouts_before + 1 ||
+      waited_ms < timeout_ms) {
+    std::cout << "FAILED: exhausted pool did not time out as configured"
+              << std::endl;
+    passed = false;
+  }
+  // 归还后可以再次借出
+  first.Release();
+  if (!pool.Acquire()) {
+    std::cout << "FAILED: returned connection cannot be acquired again"
+              << std::endl;
+    passed = false;
+  }
+
+  RedisManager::GetInstance()->Close();
+  std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+  return passed ? 0 : 1;
+}
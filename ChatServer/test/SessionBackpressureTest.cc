@@ -0,0 +1,121 @@
+#include <latch>
+
+#include "AsioIOServicePool.hpp"
+#include "CServer.hpp"
+#include "CSession.hpp"
+#include "ConfigManager.hpp"
+#include "LogicSystem.hpp"
+#include "Metrics.hpp"
+
+// 客户端一次写入大量小消息, 检查session投递给logic尚未处理完的消息数
+// 不超过SessionHighWatermark, 并且暂停期间留在缓冲区中的消息最终全部处理.
+// 使用test/.config, 只有一个io线程和一个logic线程, 不需要redis和mysql
+namespace {
+const int kFrameCount = 2000;
+const int kBodyLen = 4;
+const int kTimeoutSec = 30;
+
+void AppendFrame(std::string& out, short msg_id) {
+  uint16_t id_net =
+      boost::asio::detail::socket_ops::host_to_network_short(msg_id);
+  uint16_t len_net =
+      boost::asio::detail::socket_ops::host_to_network_short(kBodyLen);
+  out.append(reinterpret_cast<const char*>(&id_net), kHeadIdLen);
+  out.append(reinterpret_cast<const char*>(&len_net), kHeadDataLen);
+  out.append(kBodyLen, 'x');
+}
+
+// 等待条件成立, 超时返回false
+template <typename F>
+bool WaitFor(F pred) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(kTimeoutSec);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+}  // namespace
+
+int main() {
+  auto high = std::stoi(
+      ConfigManager::GetInstance()["Logic"]["SessionHighWatermark"]);
+  auto pool = AsioIOServicePool::GetInstance();
+  auto& handled = Metrics::GetInstance()->Counter("logic.worker0.handled");
+
+  // 第一条消息的处理协程阻塞logic线程, 直到放行之前消息全部积压在session上
+  std::latch release(1);
+  std::mutex mtx;
+  std::shared_ptr<CSession> session;
+  LogicSystem::GetInstance()->RegisterHandler(
+      ID_SEARCH_USER_REQ,
+      [&](std::shared_ptr<CSession> from, uint16_t,
+          std::string_view) -> net::awaitable<void> {
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          if (session == nullptr) {
+            session = from;
+          }
+        }
+        release.wait();
+        co_return;
+      });
+  auto get_session = [&]() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return session;
+  };
+
+  net::io_context ioc;
+  auto work = net::make_work_guard(ioc);
+  CServer server(ioc, 0);
+  std::thread accept_thread([&ioc]() { ioc.run(); });
+
+  net::io_context client_ioc;
+  tcp::socket client(client_ioc);
+  client.connect(
+      tcp::endpoint(net::ip::address_v4::loopback(), server.GetPort()));
+  std::string frames;
+  for (int i = 0; i < kFrameCount; ++i) {
+    AppendFrame(frames, ID_SEARCH_USER_REQ);
+  }
+  net::write(client, net::buffer(frames));
+
+  // logic停住时, 读取一定会因为session积压而暂停
+  bool paused = WaitFor([&]() {
+    auto current = get_session();
+    return current != nullptr && current->IsReadPaused();
+  });
+  int pending = paused ? get_session()->GetLogicPending() : 0;
+  release.count_down();
+  bool drained = WaitFor([&handled]() { return handled == kFrameCount; });
+  int64_t handled_count = handled;
+
+  // 断开走正常的清理流程
+  client.close();
+  WaitFor([&]() {
+    auto current = get_session();
+    return current == nullptr || current->IsClosed();
+  });
+  pool->Stop();
+  work.reset();
+  ioc.stop();
+  accept_thread.join();
+
+  std::cout << "paused " << paused << " pending " << pending << " handled "
+            << handled_count << std::endl;
+  if (!paused || pending > high) {
+    std::cout << "FAILED: logic pending exceeds high watermark " << high
+              << std::endl;
+    return 1;
+  }
+  if (!drained) {
+    std::cout << "FAILED: read did not resume, handled " << handled_count
+              << " of " << kFrameCount << std::endl;
+    return 1;
+  }
+  std::cout << "PASSED" << std::endl;
+  return 0;
+}
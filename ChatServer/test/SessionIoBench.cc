@@ -0,0 +1,176 @@
+#include <sys/resource.h>
+
+#include "AsioIOServicePool.hpp"
+#include "CServer.hpp"
+#include "ConfigManager.hpp"
+#include "Metrics.hpp"
+
+// session读写路径的基准: 大量连接各自循环发送心跳请求并等待回包, 心跳在
+// io线程内处理, 不经过logic, 测到的是socket读写和消息解析的开销.
+// 分别运行session_io_bench(epoll)和session_io_bench_uring(io_uring)比较,
+// 每条消息的系统调用数用perf统计, 例如
+//   perf stat -e raw_syscalls:sys_enter ./session_io_bench 10000 10
+// 用法: session_io_bench [连接数] [秒数] [客户端线程数]
+namespace {
+const int kDefaultConnections = 10000;
+const int kDefaultSeconds = 10;
+const int kCloseTimeoutSec = 30;
+
+// 每个连接的往返延迟(微秒), 只由运行该连接协程的线程写入
+struct ClientStats {
+  std::vector<uint32_t> latencies_;
+};
+
+net::awaitable<void> RunClient(tcp::socket socket,
+                               std::chrono::steady_clock::time_point deadline,
+                               ClientStats& stats) {
+  char request[kHeadTotalLen] = {0};
+  uint16_t id_net =
+      boost::asio::detail::socket_ops::host_to_network_short(
+          ID_HEART_BEAT_REQ);
+  memcpy(request, &id_net, kHeadIdLen);
+  char head[kHeadTotalLen];
+  std::vector<char> body;
+  boost::system::error_code ec;
+  while (std::chrono::steady_clock::now() < deadline) {
+    auto start = std::chrono::steady_clock::now();
+    co_await net::async_write(socket, net::buffer(request),
+                              net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      break;
+    }
+    co_await net::async_read(socket, net::buffer(head),
+                             net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      break;
+    }
+    uint16_t len_net = 0;
+    memcpy(&len_net, head + kHeadIdLen, kHeadDataLen);
+    body.resize(
+        boost::asio::detail::socket_ops::network_to_host_short(len_net));
+    co_await net::async_read(socket, net::buffer(body),
+                             net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      break;
+    }
+    stats.latencies_.push_back(static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count()));
+  }
+  socket.close(ec);
+}
+
+// 按进程的文件描述符上限调整连接数, 每个连接两端各占一个
+int FitConnections(int connections) {
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  int max_connections = static_cast<int>((limit.rlim_cur - 256) / 2);
+  if (connections > max_connections) {
+    std::cout << "fd limit " << limit.rlim_cur << ", connections reduced to "
+              << max_connections << std::endl;
+    return max_connections;
+  }
+  return connections;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int connections =
+      FitConnections(argc > 1 ? std::stoi(argv[1]) : kDefaultConnections);
+  int seconds = argc > 2 ? std::stoi(argv[2]) : kDefaultSeconds;
+  int client_threads =
+      argc > 3 ? std::stoi(argv[3])
+               : std::max<int>(std::thread::hardware_concurrency(), 1);
+#ifdef BOOST_ASIO_HAS_IO_URING
+  std::cout << "asio backend is io_uring" << std::endl;
+#else
+  std::cout << "asio backend is epoll" << std::endl;
+#endif
+  ConfigManager::GetInstance();
+  auto pool = AsioIOServicePool::GetInstance();
+  auto& write_calls = Metrics::GetInstance()->Counter("session.write_calls");
+  auto& write_frames = Metrics::GetInstance()->Counter("session.write_frames");
+
+  net::io_context ioc;
+  auto work = net::make_work_guard(ioc);
+  CServer server(ioc, 0);
+  std::thread accept_thread([&ioc]() { ioc.run(); });
+
+  // 先建立全部连接, 再同时开始计时
+  net::io_context client_ioc;
+  tcp::endpoint endpoint(net::ip::address_v4::loopback(), server.GetPort());
+  std::vector<tcp::socket> sockets;
+  sockets.reserve(connections);
+  for (int i = 0; i < connections; ++i) {
+    sockets.emplace_back(client_ioc);
+    sockets.back().connect(endpoint);
+  }
+  std::cout << "connections " << connections << ", seconds " << seconds
+            << ", client threads " << client_threads << std::endl;
+
+  int64_t calls_before = write_calls;
+  int64_t frames_before = write_frames;
+  std::vector<ClientStats> stats(connections);
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::seconds(seconds);
+  for (int i = 0; i < connections; ++i) {
+    net::co_spawn(client_ioc,
+                  RunClient(std::move(sockets[i]), deadline, stats[i]),
+                  net::detached);
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < client_threads; ++i) {
+    threads.emplace_back([&client_ioc]() { client_ioc.run(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  std::vector<uint32_t> latencies;
+  for (auto& stat : stats) {
+    latencies.insert(latencies.end(), stat.latencies_.begin(),
+                     stat.latencies_.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) -> uint32_t {
+    if (latencies.empty()) {
+      return 0;
+    }
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+  };
+  int64_t calls = write_calls - calls_before;
+  int64_t frames = write_frames - frames_before;
+  std::cout << "messages " << latencies.size() << ", "
+            << static_cast<int64_t>(latencies.size() / elapsed) << " msg/s"
+            << std::endl;
+  std::cout << "rtt p50 " << percentile(0.5) << "us, p99 " << percentile(0.99)
+            << "us, max " << percentile(1.0) << "us" << std::endl;
+  std::cout << "server write calls " << calls << ", frames per write "
+            << (calls == 0 ? 0.0 : static_cast<double>(frames) / calls)
+            << std::endl;
+
+  // 等服务端清理完断开的session再停止, 只剩acceptor预先创建的一个
+  auto close_deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(kCloseTimeoutSec);
+  while (std::chrono::steady_clock::now() < close_deadline) {
+    int64_t sessions = 0;
+    for (std::size_t i = 0; i < pool->Size(); ++i) {
+      sessions += pool->SessionCount(pool->GetIOService(i));
+    }
+    if (sessions <= 1) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  pool->Stop();
+  work.reset();
+  ioc.stop();
+  accept_thread.join();
+  return 0;
+}
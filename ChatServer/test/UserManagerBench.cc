@@ -0,0 +1,127 @@
+#include "AsioIOServicePool.hpp"
+#include "CSession.hpp"
+#include "UserManager.hpp"
+
+// uid到session查找的基准: 多个线程随机查找已登录的uid, 比较UserManager的
+// 稠密表加锁条带, 原先的全局锁哈希表, 以及每个uid一个
+// atomic<shared_ptr>的无锁读. 每次查找都拷贝出shared_ptr, 与投递路径相同.
+// 用法: user_manager_bench [线程数] [每个线程的查找次数]
+namespace {
+const int kDefaultThreads = 32;
+const int64_t kDefaultLookups = 1000000;
+const int kUserCount = 4096;
+const int kFirstUid = 1001;
+
+// 改为稠密表之前的实现
+class GlobalMapUsers {
+ public:
+  void Set(int uid, std::shared_ptr<CSession> session) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    sessions_[uid] = std::move(session);
+  }
+
+  std::shared_ptr<CSession> Get(int uid) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = sessions_.find(uid);
+    return it == sessions_.end() ? nullptr : it->second;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::unordered_map<int, std::shared_ptr<CSession>> sessions_;
+};
+
+// 请求中提出的无锁读方案, 按uid直接索引
+class AtomicSlotUsers {
+ public:
+  AtomicSlotUsers() : slots_(kFirstUid + kUserCount) {}
+
+  void Set(int uid, std::shared_ptr<CSession> session) {
+    slots_[uid].store(std::move(session));
+  }
+
+  std::shared_ptr<CSession> Get(int uid) { return slots_[uid].load(); }
+
+ private:
+  std::vector<std::atomic<std::shared_ptr<CSession>>> slots_;
+};
+
+// 返回每秒查找次数, 查找不到已登录的uid时计入misses
+template <typename F>
+double Run(int threads, int64_t lookups, F get, std::atomic<int64_t>& misses) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&get, &misses, lookups, t]() {
+      uint32_t state = 2463534242u + t;
+      int64_t missed = 0;
+      for (int64_t i = 0; i < lookups; ++i) {
+        // xorshift, 避免随机数生成成为瓶颈
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if (get(kFirstUid + static_cast<int>(state % kUserCount)) ==
+            nullptr) {
+          ++missed;
+        }
+      }
+      misses += missed;
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return threads * lookups / elapsed;
+}
+
+void Report(const char* name, double rate) {
+  std::cout << name << ": " << static_cast<int64_t>(rate) << " lookups/s"
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int threads = argc > 1 ? std::stoi(argv[1]) : kDefaultThreads;
+  int64_t lookups = argc > 2 ? std::stoll(argv[2]) : kDefaultLookups;
+  std::cout << "threads " << threads << ", lookups per thread " << lookups
+            << ", users " << kUserCount << std::endl;
+
+  // session只作为映射的值, 不启动读写
+  auto pool = AsioIOServicePool::GetInstance();
+  auto users = UserManager::GetInstance();
+  GlobalMapUsers global_map;
+  AtomicSlotUsers atomic_slots;
+  std::vector<std::shared_ptr<CSession>> sessions;
+  for (int i = 0; i < kUserCount; ++i) {
+    auto session = std::make_shared<CSession>(pool->GetIOService(), nullptr);
+    users->SetUserSession(kFirstUid + i, session);
+    global_map.Set(kFirstUid + i, session);
+    atomic_slots.Set(kFirstUid + i, session);
+    sessions.push_back(std::move(session));
+  }
+
+  std::atomic<int64_t> misses(0);
+  Report("UserManager striped table",
+         Run(threads, lookups,
+             [&users](int uid) { return users->GetSession(uid); }, misses));
+  Report("global mutex map",
+         Run(threads, lookups,
+             [&global_map](int uid) { return global_map.Get(uid); }, misses));
+  Report("atomic<shared_ptr> slots",
+         Run(threads, lookups,
+             [&atomic_slots](int uid) { return atomic_slots.Get(uid); },
+             misses));
+
+  for (int i = 0; i < kUserCount; ++i) {
+    users->RemoveUserSession(kFirstUid + i, sessions[i]);
+  }
+  pool->Stop();
+  if (misses != 0) {
+    std::cout << "FAILED: " << misses << " lookups missed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,21 +1,23 @@
 #pragma once
 
+// boost 1.74的asio/awaitable.hpp用到std::exchange却没有包含<utility>
+#include <utility>
+
 // boost
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_generators.hpp>
-#include <boost/uuid/uuid_io.hpp>
 
 // std
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
 #include <csignal>
+#include <cstring>
 #include <exception>
 #include <filesystem>
 #include <functional>
@@ -23,6 +25,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <string>
 #include <thread>
@@ -59,6 +62,9 @@ enum ErrorCodes {
   PasswdInvalid = 1009,   // 密码更新失败
   TokenInvalid = 1010,    // Token失效
   UidInvalid = 1011,      // uid无效
+  SlowConsumer = 1012,    // 接收过慢被断开
+  ServerDraining = 1013,  // 服务器下线, 需要重新登录到其它服务器
+  UserOffline = 1014,     // 用户不在该服务器上
 };
 
 enum MSG_IDS {
@@ -75,6 +81,11 @@ enum MSG_IDS {
   ID_TEXT_CHAT_MSG_REQ = 1017,         // 文本聊天信息请求
   ID_TEXT_CHAT_MSG_RSP = 1018,         // 文本聊天信息回复
   ID_NOTIFY_TEXT_CHAT_MSG_REQ = 1019,  // 通知用户文本聊天信息
+  ID_PROTOCOL_REQ = 1021,              // 协商消息头版本
+  ID_PROTOCOL_RSP = 1022,              // 协商消息头版本回包
+  ID_NOTIFY_KICK_REQ = 1023,           // 通知用户连接被服务端断开
+  ID_HEART_BEAT_REQ = 1025,            // 心跳请求
+  ID_HEART_BEAT_RSP = 1026,            // 心跳回包
 };
 
 const std::string kCodePrefix = "code_";
@@ -82,15 +93,55 @@ const std::string kUserTokenPrefix = "utoken_";
 const std::string kUserIpPrefix = "uip_";
 const std::string kIpCountPrefix = "ipcount_";
 const std::string kUserBaseInfo = "ubaseinfo_";
+// 用户资料变化时向该频道发布uid, 各ChatServer据此删除本地缓存
+const std::string kUserInfoChannel = "userinfo_changed";
+// 用户登录和断开时发布"login|logout uid server", 各ChatServer据此更新路由缓存
+const std::string kUserRouteChannel = "user_route";
 const std::string kLoginCount = "logincount";
+// 正在下线的聊天服务器, StatusServer不再向其分配新用户
+const std::string kDrainingServers = "drainingservers";
 const std::string kNameInfo = "nameinfo_";
 
 const int kMaxLength = 2048;
+// v1消息头: id(2) + len(2)
 const int kHeadTotalLen = 4;
 const int kHeadIdLen = 2;
 const int kHeadDataLen = 2;
+// v2消息头: id(2) + flags(2) + len(4)
+const int kHeadTotalLenV2 = 8;
+const int kHeadFlagsLen = 2;
+const int kHeadDataLenV2 = 4;
+const int kProtocolV1 = 1;
+const int kProtocolV2 = 2;
+// SendNode在消息体前预留的空间, 能容纳任一版本的消息头
+const int kSendHeadRoom = kHeadTotalLenV2;
+// v2消息头flags: 消息体经过压缩
+const uint16_t kFlagCompressed = 0x0001;
+// 压缩消息体前的原始长度字段
+const int kCompressLenSize = 4;
+// 登录时协商的消息体编码
+const int kCodecJson = 0;
+const int kCodecProtobuf = 1;
+// v2单条消息体的默认上限, 可通过[Session] MaxRecvBytes配置
+const uint32_t kDefaultMaxRecvBytes = 1024 * 1024;
+// 每个session的环形接收缓冲区大小, 至少容纳一个完整的消息
+const int kRecvBufLen = 8192;
+// 每个logic worker入队消息的上限, 默认的积压高水位取它的一半
 const int kMaxRecvQue = 10000;
-const int kMaxSendQue = 1000;
+// 单个session在logic中排队的消息数达到该值时暂停读取
+const int kDefaultSessionHighWater = 64;
+// 空闲session回收时间轮的精度, 以及默认的空闲超时,
+// 超时可通过[Session] IdleTimeoutSec配置, 为0时不回收
+const int kWheelTickMs = 1000;
+const uint64_t kDefaultIdleTimeoutSec = 60;
+// 每个session发送队列默认的字节预算, 可通过[Session] SendBudgetBytes配置
+const int64_t kDefaultSendBudgetBytes = 1024 * 1024;
+// 一次写操作持续超过该时间, 或者按最近的写出速率排空队列需要超过该时间,
+// 认为是慢消费者, 可通过[Session] SlowConsumerMs配置
+const int64_t kDefaultSlowConsumerMs = 10000;
+// 一次gather写最多合并的消息数和字节数
+const std::size_t kMaxGatherNodes = 64;
+const std::size_t kMaxGatherBytes = 64 * 1024;
 
 class Defer {
  public:
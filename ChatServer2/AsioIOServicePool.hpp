@@ -2,6 +2,8 @@
 #include "Singleton.hpp"
 #include "utilities.hpp"
 
+class TimingWheel;
+
 class AsioIOServicePool : public Singleton<AsioIOServicePool> {
   friend Singleton<AsioIOServicePool>;
 
@@ -13,14 +15,42 @@ class AsioIOServicePool : public Singleton<AsioIOServicePool> {
   ~AsioIOServicePool();
   AsioIOServicePool(const AsioIOServicePool&) = delete;
   AsioIOServicePool& operator=(const AsioIOServicePool&) = delete;
-  // 使用 round-robin 的方式返回一个 io_service
+  // 返回session最少的io_context, 调度滞后超过阈值的尽量不选, 可多线程调用
   boost::asio::io_context& GetIOService();
+  std::size_t Size() const;
+  boost::asio::io_context& GetIOService(std::size_t index);
+  // 返回io_context对应的时间轮, 只能在该io_context的线程中使用
+  TimingWheel& GetWheel(const boost::asio::io_context& ioc);
+  // io_context上的session数, session创建和析构时增减
+  std::atomic<int64_t>& SessionCount(const boost::asio::io_context& ioc);
   void Stop();
 
  private:
-  AsioIOServicePool(std::size_t size = std::thread::hardware_concurrency());
+  // 每个io_context的负载统计, 计数器同时由Metrics输出
+  struct ContextStats {
+    explicit ContextStats(IOService& ioc) : probe_(ioc) {}
+
+    std::atomic<int64_t>* sessions_;
+    // 探测定时器实际触发比预期晚的时间, 反映handler排队的长度
+    std::atomic<int64_t>* lag_us_;
+    // 以下成员只在该io_context的线程访问
+    net::steady_timer probe_;
+    std::chrono::steady_clock::time_point expected_;
+  };
+
+  AsioIOServicePool();
+  std::size_t IndexOf(const boost::asio::io_context& ioc) const;
+  // 按[IOPool] CpuList把第index个线程绑定到对应的cpu
+  void PinThread(std::size_t index);
+  void Probe(std::size_t index);
+
   std::vector<IOService> ioservices_;
+  // 与ioservices_一一对应, 先于ioservices_析构
+  std::vector<std::unique_ptr<TimingWheel>> wheels_;
+  std::vector<std::unique_ptr<ContextStats>> stats_;
   std::vector<WorkPtr> works_;
   std::vector<std::thread> threads_;
-  std::size_t next_ioservice_;
+  std::vector<int> cpus_;
+  int64_t lag_limit_us_;
+  std::atomic<std::size_t> next_ioservice_;
 };
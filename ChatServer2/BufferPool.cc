@@ -0,0 +1,118 @@
+#include "BufferPool.hpp"
+
+namespace {
+// 全局仓库, 每一级一把锁
+struct Depot {
+  std::mutex mtx_[BufferPool::kClassCount];
+  std::vector<char*> blocks_[BufferPool::kClassCount];
+
+  // 把[first, last)的块放回第index级, 超过上限的部分释放
+  void Put(std::size_t index, char** first, char** last) {
+    std::size_t limit = std::max(
+        BufferPool::kDepotLimitBytes / (BufferPool::kMinClassSize << index),
+        BufferPool::kBatchSize);
+    std::lock_guard<std::mutex> lock(mtx_[index]);
+    auto& blocks = blocks_[index];
+    std::size_t room = limit > blocks.size() ? limit - blocks.size() : 0;
+    std::size_t count = std::min<std::size_t>(room, last - first);
+    blocks.insert(blocks.end(), first, first + count);
+    for (auto* it = first + count; it != last; ++it) {
+      delete[] *it;
+    }
+  }
+};
+
+Depot& GetDepot() {
+  // 有的线程在静态对象析构之后才退出, 仍要把线程缓存交回仓库,
+  // 所以仓库不随静态对象析构, 进程退出时由系统回收
+  static Depot* depot = new Depot;
+  return *depot;
+}
+
+thread_local bool t_cache_destroyed = false;
+
+// 线程本地缓存, 线程退出时把缓存的块交回仓库
+struct ThreadCache {
+  ThreadCache() : depot_(GetDepot()) {}
+  ~ThreadCache() {
+    for (std::size_t i = 0; i < BufferPool::kClassCount; ++i) {
+      depot_.Put(i, free_[i].data(), free_[i].data() + free_[i].size());
+    }
+    t_cache_destroyed = true;
+  }
+
+  Depot& depot_;
+  std::vector<char*> free_[BufferPool::kClassCount];
+};
+
+thread_local ThreadCache t_cache;
+
+// 线程退出后(例如静态对象析构时)不再使用线程缓存
+ThreadCache* LocalCache() {
+  if (t_cache_destroyed) {
+    return nullptr;
+  }
+  return &t_cache;
+}
+}  // namespace
+
+std::size_t BufferPool::SizeClass(std::size_t size) {
+  std::size_t index = 0;
+  std::size_t class_size = kMinClassSize;
+  while (class_size < size) {
+    class_size <<= 1;
+    ++index;
+  }
+  return index;
+}
+
+char* BufferPool::Allocate(std::size_t size) {
+  if (size > kMaxClassSize) {
+    return new char[size];
+  }
+  std::size_t index = SizeClass(size);
+  auto* cache = LocalCache();
+  if (cache == nullptr) {
+    return new char[kMinClassSize << index];
+  }
+  auto& free_list = cache->free_[index];
+  if (free_list.empty()) {
+    // 从仓库批量取回
+    auto& depot = cache->depot_;
+    std::lock_guard<std::mutex> lock(depot.mtx_[index]);
+    auto& blocks = depot.blocks_[index];
+    std::size_t count = std::min(kBatchSize, blocks.size());
+    free_list.insert(free_list.end(), blocks.end() - count, blocks.end());
+    blocks.resize(blocks.size() - count);
+  }
+  if (free_list.empty()) {
+    return new char[kMinClassSize << index];
+  }
+  char* block = free_list.back();
+  free_list.pop_back();
+  return block;
+}
+
+void BufferPool::Deallocate(char* ptr, std::size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size > kMaxClassSize) {
+    delete[] ptr;
+    return;
+  }
+  auto* cache = LocalCache();
+  if (cache == nullptr) {
+    delete[] ptr;
+    return;
+  }
+  std::size_t index = SizeClass(size);
+  auto& free_list = cache->free_[index];
+  free_list.push_back(ptr);
+  if (free_list.size() > kThreadCacheLimit) {
+    // 在logic线程释放的接收缓冲区会堆积在这里, 批量归还给仓库
+    char** last = free_list.data() + free_list.size();
+    cache->depot_.Put(index, last - kBatchSize, last);
+    free_list.resize(free_list.size() - kBatchSize);
+  }
+}
@@ -6,16 +6,44 @@ class CServer : public std::enable_shared_from_this<CServer> {
  public:
   CServer(net::io_context& ioc, uint16_t port);
   ~CServer();
-  void ClearSession(std::string session_id);
+  void ClearSession(uint64_t session_id);
+  // 实际监听的端口, port传0时由系统分配
+  uint16_t GetPort() const;
+  // 停止接受新连接, 分批通知已有session到其它服务器重连,
+  // 全部断开或超时后在主ioc上调用on_done
+  void Drain(std::function<void()> on_done);
 
  private:
-  void HandleAccept(std::shared_ptr<CSession> session,
+  void HandleAccept(std::size_t index, std::shared_ptr<CSession> session,
                     const boost::system::error_code& ec);
-  void StartAccpet();
+  void StartAccpet(std::size_t index);
+  void DrainBatch();
+  void WaitDrained();
+  std::size_t SessionCount();
+
+  static const std::size_t kShardCount = 16;
+  // 按session id分片, 不同session的接入和断开互不争用
+  struct Shard {
+    std::mutex mtx_;
+    std::unordered_map<uint64_t, std::shared_ptr<CSession>> sessions_;
+  };
+  Shard& ShardOf(uint64_t session_id);
 
   net::io_context& ioc_;
-  tcp::acceptor acceptor_;
   uint16_t port_;
-  std::unordered_map<std::string, std::shared_ptr<CSession>> sessions_;
-  std::mutex mtx_;
+  // 开启[SelfServer] ReusePort时每个io_context一个SO_REUSEPORT的acceptor,
+  // 由内核把连接分散到各个线程, session留在接受它的io_context上.
+  // 否则只有一个主ioc上的acceptor, 按轮询把session分给io_context
+  bool reuse_port_;
+  std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
+  // 以下成员用于下线, 除draining_外只在主ioc线程访问
+  std::atomic<bool> draining_;
+  net::steady_timer drain_timer_;
+  std::vector<std::weak_ptr<CSession>> drain_sessions_;
+  std::size_t drain_next_;
+  std::size_t drain_batch_;
+  std::chrono::milliseconds drain_interval_;
+  std::chrono::steady_clock::time_point drain_deadline_;
+  std::function<void()> on_drained_;
+  Shard shards_[kShardCount];
 };
\ No newline at end of file
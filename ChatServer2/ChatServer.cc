@@ -2,16 +2,38 @@
 #include "CServer.hpp"
 #include "ChatServerService.hpp"
 #include "ConfigManager.hpp"
+#include "Metrics.hpp"
 #include "RedisManager.hpp"
+#include "RouteCache.hpp"
+#include "UserInfoCache.hpp"
 #include "utilities.hpp"
 
+// 定时输出进程内计数器
+void ReportMetrics(net::steady_timer& timer, int interval) {
+  timer.expires_after(std::chrono::seconds(interval));
+  timer.async_wait([&timer, interval](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    std::cout << "[metrics] " << Metrics::GetInstance()->Dump() << std::endl;
+    ReportMetrics(timer, interval);
+  });
+}
+
 int main() {
   auto& config_manager = ConfigManager::GetInstance();
   std::string server_name = config_manager["SelfServer"]["Name"];
   try {
+#ifdef BOOST_ASIO_HAS_IO_URING
+    std::cout << "asio backend is io_uring" << std::endl;
+#else
+    std::cout << "asio backend is epoll" << std::endl;
+#endif
     auto pool = AsioIOServicePool::GetInstance();
 
     RedisManager::GetInstance()->HSet(kLoginCount, server_name, "0");
+    UserInfoCache::GetInstance()->Subscribe();
+    RouteCache::GetInstance()->Subscribe();
 
     ChatServerService service;
     grpc::ServerBuilder builder;
@@ -21,21 +43,42 @@ int main() {
     builder.RegisterService(&service);
     std::unique_ptr<grpc::Server> grpc_server(builder.BuildAndStart());
     std::thread grpc_thread([&grpc_server]() { grpc_server->Wait(); });
+
     boost::asio::io_context ioc;
-    boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
-    signals.async_wait(
-        [&ioc, pool, &grpc_server](boost::system::error_code, int) {
-          ioc.stop();
-          pool->Stop();
-          grpc_server->Shutdown();
-        });
     std::string port = config_manager["SelfServer"]["Port"];
     CServer server(ioc, atoi(port.c_str()));
+    auto stop = [&ioc, pool, &grpc_server]() {
+      ioc.stop();
+      pool->Stop();
+      grpc_server->Shutdown();
+    };
+    // 第一次收到信号时下线: 让StatusServer不再分配新用户, 分批通知客户端
+    // 重连到其它服务器, 等发送队列写完后再停止. 再次收到信号时立即停止
+    boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&](boost::system::error_code ec, int) {
+      if (ec) {
+        return;
+      }
+      RedisManager::GetInstance()->HSet(kDrainingServers, server_name, "1");
+      signals.async_wait([&stop](boost::system::error_code ec, int) {
+        if (!ec) {
+          stop();
+        }
+      });
+      server.Drain(stop);
+    });
+    net::steady_timer metrics_timer(ioc);
+    int metrics_interval = atoi(config_manager["Metrics"]["Interval"].c_str());
+    if (metrics_interval > 0) {
+      ReportMetrics(metrics_timer, metrics_interval);
+    }
     ioc.run();
     RedisManager::GetInstance()->HDel(kLoginCount, server_name);
+    RedisManager::GetInstance()->HDel(kDrainingServers, server_name);
     grpc_thread.join();
   } catch (std::exception& e) {
     RedisManager::GetInstance()->HDel(kLoginCount, server_name);
+    RedisManager::GetInstance()->HDel(kDrainingServers, server_name);
     std::cerr << "Exception: " << e.what() << std::endl;
   }
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "Compressor.hpp"
+
+#include <zlib.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "BufferPool.hpp"
+#include "ConfigManager.hpp"
+#include "Metrics.hpp"
+#include "MsgNode.hpp"
+
+namespace {
+// 未配置字典文件时使用的内置字典, 由登录回包和聊天消息中常见的片段组成,
+// deflate优先匹配靠后的内容, 越常见的片段放得越靠后
+const char kDefaultDict[] =
+    "\"email\":\"\",\"pwd\":\"\",\"status\":0,\"back\":\"\","
+    "\"apply_list\":[],\"friend_list\":[{\"uid\":,\"name\":\"\","
+    "\"desc\":\"\",\"icon\":\":/res/head_1.jpg\",\"nick\":\"\",\"sex\":0,"
+    "\"applyuid\":,\"applyname\":\"\",\"bakname\":\"\","
+    "{\"error\":0,\"fromuid\":,\"touid\":,\"text_array\":[{\"msgid\":\"\","
+    "\"content\":\"\"}]}";
+
+const int kDefaultThreshold = 256;
+
+// 线程本地的压缩上下文, 每次压缩前reset并重新设置字典
+struct DeflateContext {
+  DeflateContext() : inited_(false) {}
+  ~DeflateContext() {
+    if (inited_) {
+      deflateEnd(&stream_);
+    }
+  }
+
+  z_stream stream_;
+  bool inited_;
+};
+
+struct InflateContext {
+  InflateContext() : inited_(false) {}
+  ~InflateContext() {
+    if (inited_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  z_stream stream_;
+  bool inited_;
+};
+
+std::string LoadDict(const std::string& path) {
+  if (path.empty()) {
+    return std::string(kDefaultDict, sizeof(kDefaultDict) - 1);
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cout << "open compress dict " << path
+              << " failed, use default dict" << std::endl;
+    return std::string(kDefaultDict, sizeof(kDefaultDict) - 1);
+  }
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+}  // namespace
+
+Compressor::Compressor() {
+  auto& cfg = ConfigManager::GetInstance();
+  enabled_ = cfg["Compress"]["Enable"] == "true";
+  auto threshold = cfg["Compress"]["Threshold"];
+  threshold_ = threshold.empty() ? kDefaultThreshold : std::stoul(threshold);
+  auto level = cfg["Compress"]["Level"];
+  level_ = level.empty() ? Z_BEST_SPEED : std::stoi(level);
+  dict_ = LoadDict(cfg["Compress"]["Dict"]);
+  std::cout << "compress enabled " << enabled_ << " threshold " << threshold_
+            << " dict size " << dict_.size() << std::endl;
+}
+
+Compressor::~Compressor() {}
+
+bool Compressor::Enabled() const { return enabled_; }
+
+std::shared_ptr<SendNode> Compressor::Compress(
+    const std::shared_ptr<SendNode>& node) {
+  static auto& frames = Metrics::GetInstance()->Counter("compress.frames");
+  static auto& bytes_in = Metrics::GetInstance()->Counter("compress.bytes_in");
+  static auto& bytes_out =
+      Metrics::GetInstance()->Counter("compress.bytes_out");
+
+  uint32_t body_len = node->BodyLen();
+  if (body_len < threshold_ || body_len <= kCompressLenSize) {
+    return nullptr;
+  }
+
+  thread_local DeflateContext ctx;
+  z_stream& stream = ctx.stream_;
+  if (!ctx.inited_) {
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, level_) != Z_OK) {
+      return nullptr;
+    }
+    ctx.inited_ = true;
+  } else {
+    deflateReset(&stream);
+  }
+  deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dict_.data()),
+                       dict_.size());
+
+  // 压缩结果不比原消息体小就没有意义, 输出空间按原长度分配即可
+  auto compressed = MakePooled<SendNode>(body_len, node->msg_id_);
+  char* out = compressed->Body();
+  uint32_t len_net = boost::asio::detail::socket_ops::host_to_network_long(
+      body_len);
+  memcpy(out, &len_net, kCompressLenSize);
+
+  stream.next_in = reinterpret_cast<Bytef*>(node->Body());
+  stream.avail_in = body_len;
+  stream.next_out = reinterpret_cast<Bytef*>(out + kCompressLenSize);
+  stream.avail_out = body_len - kCompressLenSize;
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    return nullptr;
+  }
+
+  compressed->body_len_ = kCompressLenSize + stream.total_out;
+  compressed->flags_ = kFlagCompressed;
+  frames++;
+  bytes_in += body_len;
+  bytes_out += compressed->body_len_;
+  return compressed;
+}
+
+std::shared_ptr<RecvNode> Compressor::Decompress(
+    const std::shared_ptr<RecvNode>& node, uint32_t max_len) {
+  if (node->curr_len_ < kCompressLenSize) {
+    return nullptr;
+  }
+  uint32_t len_net = 0;
+  memcpy(&len_net, node->data_, kCompressLenSize);
+  uint32_t raw_len =
+      boost::asio::detail::socket_ops::network_to_host_long(len_net);
+  if (raw_len > max_len) {
+    std::cout << "Invalid decompressed length is " << raw_len << std::endl;
+    return nullptr;
+  }
+
+  thread_local InflateContext ctx;
+  z_stream& stream = ctx.stream_;
+  if (!ctx.inited_) {
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+      return nullptr;
+    }
+    ctx.inited_ = true;
+  } else {
+    inflateReset(&stream);
+  }
+
+  auto raw = MakePooled<RecvNode>(raw_len, node->msg_id_);
+  stream.next_in = reinterpret_cast<Bytef*>(node->data_ + kCompressLenSize);
+  stream.avail_in = node->curr_len_ - kCompressLenSize;
+  stream.next_out = reinterpret_cast<Bytef*>(raw->data_);
+  stream.avail_out = raw_len;
+  int ret = inflate(&stream, Z_FINISH);
+  if (ret == Z_NEED_DICT) {
+    if (inflateSetDictionary(&stream,
+                             reinterpret_cast<const Bytef*>(dict_.data()),
+                             dict_.size()) != Z_OK) {
+      return nullptr;
+    }
+    ret = inflate(&stream, Z_FINISH);
+  }
+  if (ret != Z_STREAM_END || stream.total_out != raw_len) {
+    std::cout << "Decompress msg " << node->msg_id_ << " failed, error is "
+              << ret << std::endl;
+    return nullptr;
+  }
+  raw->curr_len_ = raw_len;
+  return raw;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Singleton.hpp"
+#include "utilities.hpp"
+
+class RecvNode;
+class SendNode;
+
+// 消息体的deflate压缩, 压缩和解压都使用同一份预置字典, 登录时协商开启.
+// 压缩后的消息体为 原始长度(4字节网络序) + zlib数据, 消息头flags带
+// kFlagCompressed标记. 每个线程持有自己的压缩/解压上下文, 不需要加锁
+class Compressor : public Singleton<Compressor> {
+  friend class Singleton<Compressor>;
+
+ public:
+  ~Compressor();
+
+  bool Enabled() const;
+  // 小于阈值或者压缩后没有变小时返回nullptr, 调用方继续发送原节点
+  std::shared_ptr<SendNode> Compress(const std::shared_ptr<SendNode>& node);
+  // 原始长度超过max_len或者数据损坏时返回nullptr
+  std::shared_ptr<RecvNode> Decompress(const std::shared_ptr<RecvNode>& node,
+                                       uint32_t max_len);
+
+ private:
+  Compressor();
+
+  bool enabled_;
+  uint32_t threshold_;
+  int level_;
+  std::string dict_;
+};
@@ -2,214 +2,263 @@
 
 #include "CSession.hpp"
 #include "ChatGrpcClient.hpp"
+#include "Compressor.hpp"
 #include "ConfigManager.hpp"
+#include "LogicWorker.hpp"
+#include "MsgCodec.hpp"
 #include "MsgNode.hpp"
 #include "MysqlManager.hpp"
-#include "RedisManager.hpp"
+#include "ProfileStore.hpp"
+#include "RedisAsyncClient.hpp"
+#include "RouteCache.hpp"
+#include "UserInfoCache.hpp"
 #include "UserManager.hpp"
 #include "data.hpp"
 
-LogicSystem::LogicSystem() : stop_(false) {
+namespace {
+std::size_t BlockingThreads() {
+  auto value = ConfigManager::GetInstance()["Logic"]["BlockingThreads"];
+  return value.empty() ? 16 : std::max<std::size_t>(std::stoul(value), 1);
+}
+}  // namespace
+
+LogicSystem::LogicSystem() : blocking_pool_(BlockingThreads()) {
   RegisterCallback();
-  worker_ = std::thread(&LogicSystem::DealMsg, this);
+  auto worker_count = ConfigManager::GetInstance()["Logic"]["WorkerCount"];
+  std::size_t count = worker_count.empty()
+                          ? std::thread::hardware_concurrency()
+                          : std::stoul(worker_count);
+  count = std::max<std::size_t>(count, 1);
+  for (std::size_t i = 0; i < count; ++i) {
+    workers_.push_back(std::make_unique<LogicWorker>(
+        i, std::bind(&LogicSystem::DealMsg, this, std::placeholders::_1)));
+  }
+  std::cout << "logic worker count is " << count << std::endl;
 }
 
 LogicSystem::~LogicSystem() {
-  stop_ = true;
-  cond_.notify_all();
-  worker_.join();
+  for (auto& worker : workers_) {
+    worker->Stop();
+  }
 }
 
-void LogicSystem::PostMsgToQue(std::shared_ptr<LogicNode> msg) {
-  std::lock_guard<std::mutex> lock(mtx_);
-  if (stop_) return;
-  msg_que_.push(msg);
-  cond_.notify_one();
+bool LogicSystem::PostMsgToQue(std::shared_ptr<LogicNode> msg) {
+  return workers_[WorkerIndex(msg->session_.get())]->Post(std::move(msg));
 }
 
-void LogicSystem::DealMsg() {
-  while (true) {
-    std::unique_lock<std::mutex> lock(mtx_);
-    cond_.wait(lock, [this]() { return !msg_que_.empty(); });
-    if (stop_) {
-      while (!msg_que_.empty()) {
-        auto logic_node = msg_que_.front();
-        std::cout << "Recv_msg id  is " << logic_node->recvnode_->msg_id_
-                  << std::endl;
-        auto callback_it = func_callbacks_.find(logic_node->recvnode_->msg_id_);
-        if (callback_it == func_callbacks_.end()) {
-          msg_que_.pop();
-          continue;
-        }
-        callback_it->second(logic_node->session_,
-                            logic_node->recvnode_->msg_id_,
-                            std::string(logic_node->recvnode_->data_,
-                                        logic_node->recvnode_->curr_len_));
-        msg_que_.pop();
-      }
-      break;
-    }
-    auto logic_node = msg_que_.front();
-    std::cout << "Recv_msg id  is " << logic_node->recvnode_->msg_id_
-              << std::endl;
-    auto callback_it = func_callbacks_.find(logic_node->recvnode_->msg_id_);
-    if (callback_it == func_callbacks_.end()) {
-      msg_que_.pop();
-      continue;
-    }
-    callback_it->second(logic_node->session_, logic_node->recvnode_->msg_id_,
-                        std::string(logic_node->recvnode_->data_,
-                                    logic_node->recvnode_->curr_len_));
-    msg_que_.pop();
+void LogicSystem::WaitForSpace(std::shared_ptr<CSession> session) {
+  auto* worker = workers_[WorkerIndex(session.get())].get();
+  worker->WaitForSpace(std::move(session));
+}
+
+int64_t LogicSystem::Backlog(const CSession* session) const {
+  return workers_[WorkerIndex(session)]->Depth();
+}
+
+void LogicSystem::RegisterHandler(uint16_t msg_id, FunCallback callback) {
+  func_callbacks_[msg_id] = std::move(callback);
+}
+
+std::size_t LogicSystem::WorkerIndex(const CSession* session) const {
+  // session对象地址在其生命周期内不变, 乘法散列打散地址低位的对齐
+  auto addr = reinterpret_cast<std::uintptr_t>(session);
+  uint64_t hash = static_cast<uint64_t>(addr) * 0x9E3779B97F4A7C15ULL;
+  return (hash >> 32) % workers_.size();
+}
+
+net::awaitable<void> LogicSystem::DealMsg(
+    std::shared_ptr<LogicNode> logic_node) {
+  auto& recv_node = logic_node->recvnode_;
+  std::cout << "Recv_msg id  is " << recv_node->msg_id_ << std::endl;
+  auto callback_it = func_callbacks_.find(recv_node->msg_id_);
+  if (callback_it == func_callbacks_.end()) {
+    co_return;
   }
+  // logic_node在本协程内一直持有, 不需要拷贝消息体
+  co_await callback_it->second(
+      logic_node->session_, recv_node->msg_id_,
+      std::string_view(recv_node->data_, recv_node->curr_len_));
 }
 
 void LogicSystem::RegisterCallback() {
+  // 原先只注册了登录, 好友申请, 好友认证和文本消息的处理函数虽然存在却从未
+  // 分发, 这三类请求都被丢弃. 改为protobuf协议时一并注册, 请求和回包的格式
+  // 见chat.proto中对应的消息
   func_callbacks_[MSG_CHAT_LOGIN] =
       std::bind(&LogicSystem::LoginHandler, this, std::placeholders::_1,
                 std::placeholders::_2, std::placeholders::_3);
+  func_callbacks_[ID_ADD_FRIEND_REQ] =
+      std::bind(&LogicSystem::AddFriendApply, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3);
+  func_callbacks_[ID_AUTH_FRIEND_REQ] =
+      std::bind(&LogicSystem::AuthFriendApply, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3);
+  func_callbacks_[ID_TEXT_CHAT_MSG_REQ] =
+      std::bind(&LogicSystem::DealChatTextMsg, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3);
 }
 
-void LogicSystem::LoginHandler(std::shared_ptr<CSession> session,
-                               const uint16_t& msg_id,
-                               const std::string& msg_data) {
-  Json::Reader reader;
-  Json::Value root;
-  reader.parse(msg_data, root);
-  auto uid = root["uid"].asInt();
-  auto token = root["token"].asString();
-  std::cout << "user login uid is  " << uid << " user token  is " << token
-            << std::endl;
-
+net::awaitable<void> LogicSystem::LoginHandler(
+    std::shared_ptr<CSession> session, uint16_t,
+    std::string_view msg_data) {
+  chat::LoginReq req;
   // return value
-  Json::Value rv;
+  chat::LoginRsp rv;
   Defer defer([this, &rv, session]() {
-    std::string json_str = rv.toStyledString();
-    session->Send(json_str, MSG_CHAT_LOGIN_RSP);
+    MsgCodec::Send(session, rv, MSG_CHAT_LOGIN_RSP);
   });
 
+  if (!MsgCodec::Decode(msg_data, req)) {
+    rv.set_error(ErrorCodes::Error_Json);
+    co_return;
+  }
+  // 以protobuf发来的登录请求, 或者json中声明了codec, 之后都使用protobuf编码
+  if (!MsgCodec::IsJson(msg_data.data(), msg_data.size()) ||
+      req.codec() == "protobuf") {
+    session->SetCodec(kCodecProtobuf);
+  }
+
+  auto uid = req.uid();
+  auto token = req.token();
+  std::cout << "user login uid is  " << uid << " user token  is " << token
+            << std::endl;
+
   // 从redis获取用户token是否正确
   std::string token_key = kUserTokenPrefix + token;
-  std::string token_value = "";
-  bool success = RedisManager::GetInstance()->Get(token_key, token_value);
-  if (!success) {
-    rv["error"] = ErrorCodes::UidInvalid;
-    return;
+  boost::system::error_code ec;
+  auto token_reply = co_await RedisAsyncClient::GetInstance()->AsyncGet(
+      token_key, net::redirect_error(net::use_awaitable, ec));
+  if (ec || !token_reply.IsString()) {
+    rv.set_error(ErrorCodes::UidInvalid);
+    co_return;
   }
-  if (token != token_value) {
-    rv["error"] = ErrorCodes::TokenInvalid;
-    return;
+  if (token != token_reply.str_) {
+    rv.set_error(ErrorCodes::TokenInvalid);
+    co_return;
   }
-  rv["error"] = ErrorCodes::Success;
+  rv.set_error(ErrorCodes::Success);
 
   std::string uid_str = std::to_string(uid);
-  std::string base_key = kUserBaseInfo + uid_str;
   auto user_info = std::make_shared<UserInfo>();
-  success = GetBaseInfo(base_key, uid, user_info);
+  bool success = co_await LoadBaseInfo(uid, user_info);
   if (!success) {
-    rv["error"] = ErrorCodes::UidInvalid;
-    return;
+    rv.set_error(ErrorCodes::UidInvalid);
+    co_return;
+  }
+
+  if (req.compress() == "deflate" && Compressor::GetInstance()->Enabled() &&
+      session->GetProtocolVersion() == kProtocolV2) {
+    // 登录成功后才开启, 失败的回包不压缩. 每条消息由flags标明是否压缩,
+    // 登录回包本身就可以压缩发送
+    rv.set_compress("deflate");
+    session->SetCompress(true);
   }
-  rv["uid"] = uid;
-  rv["pwd"] = user_info->pwd;
-  rv["name"] = user_info->name;
-  rv["email"] = user_info->email;
-  rv["nick"] = user_info->nick;
-  rv["desc"] = user_info->desc;
-  rv["sex"] = user_info->sex;
-  rv["icon"] = user_info->icon;
-
-  // 从数据库获取申请列表
+
+  rv.set_uid(uid);
+  rv.set_pwd(user_info->pwd);
+  rv.set_name(user_info->name);
+  rv.set_email(user_info->email);
+  rv.set_nick(user_info->nick);
+  rv.set_desc(user_info->desc);
+  rv.set_sex(user_info->sex);
+  rv.set_icon(user_info->icon);
+
+  // 从数据库获取申请列表和好友列表
   std::vector<std::shared_ptr<ApplyInfo>> apply_list;
-  auto b_apply = GetFriendApplyInfo(uid, apply_list);
+  std::vector<std::shared_ptr<UserInfo>> friend_list;
+  bool b_apply = false;
+  co_await Offload([&]() {
+    b_apply = GetFriendApplyInfo(uid, apply_list);
+    GetFriendList(uid, friend_list);
+  });
   if (b_apply) {
     for (auto& apply : apply_list) {
-      Json::Value obj;
-      obj["name"] = apply->name;
-      obj["uid"] = apply->uid;
-      obj["icon"] = apply->icon;
-      obj["nick"] = apply->nick;
-      obj["sex"] = apply->sex;
-      obj["desc"] = apply->desc;
-      obj["status"] = apply->status;
-      rv["apply_list"].append(obj);
+      auto* obj = rv.add_apply_list();
+      obj->set_name(apply->name);
+      obj->set_uid(apply->uid);
+      obj->set_icon(apply->icon);
+      obj->set_nick(apply->nick);
+      obj->set_sex(apply->sex);
+      obj->set_desc(apply->desc);
+      obj->set_status(apply->status);
     }
   }
 
-  // 获取好友列表
-  std::vector<std::shared_ptr<UserInfo>> friend_list;
-  success = GetFriendList(uid, friend_list);
   for (auto& friend_ele : friend_list) {
-    Json::Value obj;
-    obj["name"] = friend_ele->name;
-    obj["uid"] = friend_ele->uid;
-    obj["icon"] = friend_ele->icon;
-    obj["nick"] = friend_ele->nick;
-    obj["sex"] = friend_ele->sex;
-    obj["desc"] = friend_ele->desc;
-    obj["back"] = friend_ele->back;
-    rv["friend_list"].append(obj);
+    auto* obj = rv.add_friend_list();
+    obj->set_name(friend_ele->name);
+    obj->set_uid(friend_ele->uid);
+    obj->set_icon(friend_ele->icon);
+    obj->set_nick(friend_ele->nick);
+    obj->set_sex(friend_ele->sex);
+    obj->set_desc(friend_ele->desc);
+    obj->set_back(friend_ele->back);
   }
 
   auto server_name = ConfigManager::GetInstance()["SelfServer"]["Name"];
-  // 将登录数量增加
-  auto rd_res = RedisManager::GetInstance()->HGet(kLoginCount, server_name);
-  int count = 0;
-  if (!rd_res.empty()) {
-    count = std::stoi(rd_res);
-  }
-
-  count++;
-  auto count_str = std::to_string(count);
-  RedisManager::GetInstance()->HSet(kLoginCount, server_name, count_str);
+  std::string ipkey = kUserIpPrefix + uid_str;
+  auto redis = RedisAsyncClient::GetInstance();
+  // 将登录数量增加, 多个worker同时登录时由redis保证原子性, 不需要等待结果
+  redis->AsyncHIncrBy(kLoginCount, server_name, 1, net::detached);
+  // 为用户设置登录ip server的名字
+  co_await redis->AsyncSet(ipkey, server_name,
+                           net::redirect_error(net::use_awaitable, ec));
   // session绑定用户uid
   session->SetUserId(uid);
-  // 为用户设置登录ip server的名字
-  std::string ipkey = kUserIpPrefix + uid_str;
-  RedisManager::GetInstance()->Set(ipkey, server_name);
   // uid和session绑定管理,方便以后踢人操作
   UserManager::GetInstance()->SetUserSession(uid, session);
-
-  return;
+  // 通知其它服务器更新路由缓存
+  RouteCache::GetInstance()->PublishLogin(uid);
 }
 
-bool LogicSystem::GetBaseInfo(const std::string& base_key, int uid,
-                              std::shared_ptr<UserInfo>& userinfo) {
-  // 有先查redis
-  std::string info_str = "";
-  bool success = RedisManager::GetInstance()->Get(base_key, info_str);
+net::awaitable<bool> LogicSystem::LoadBaseInfo(
+    int uid, std::shared_ptr<UserInfo>& userinfo) {
+  // 命中进程内缓存时不需要切换到阻塞线程池
+  auto cache = UserInfoCache::GetInstance();
+  uint64_t epoch = 0;
+  if (auto cached = cache->Get(uid, epoch)) {
+    *userinfo = *cached;
+    co_return true;
+  }
+  bool success = co_await Offload(
+      [&]() { return ProfileStore::GetInstance()->Load(uid, *userinfo); });
   if (success) {
-    Json::Reader reader;
-    Json::Value root;
-    reader.parse(info_str, root);
-    userinfo->uid = root["uid"].asInt();
-    userinfo->name = root["name"].asString();
-    userinfo->pwd = root["pwd"].asString();
-    userinfo->email = root["email"].asString();
-    userinfo->nick = root["nick"].asString();
-    userinfo->desc = root["desc"].asString();
-    userinfo->sex = root["sex"].asInt();
-    userinfo->icon = root["icon"].asString();
-    std::cout << "user login uid is  " << userinfo->uid << " name  is "
-              << userinfo->name << " pwd is " << userinfo->pwd << " email is "
-              << userinfo->email << std::endl;
-  } else {
-    // redis没有则查数据库
-    userinfo = MysqlManager::GetInstance()->GetUser(uid);
-    if (userinfo == nullptr) return false;
-    // 将数据库内容写入redis缓存
-    Json::Value redis_root;
-    redis_root["uid"] = uid;
-    redis_root["pwd"] = userinfo->pwd;
-    redis_root["name"] = userinfo->name;
-    redis_root["email"] = userinfo->email;
-    redis_root["nick"] = userinfo->nick;
-    redis_root["desc"] = userinfo->desc;
-    redis_root["sex"] = userinfo->sex;
-    redis_root["icon"] = userinfo->icon;
-    RedisManager::GetInstance()->Set(base_key, redis_root.toStyledString());
+    cache->Put(uid, *userinfo, epoch);
+  }
+  co_return success;
+}
+
+net::awaitable<void> LogicSystem::Deliver(
+    int touid, std::function<void(const std::shared_ptr<CSession>&)> local,
+    std::function<bool(const std::string& server)> remote) {
+  auto routes = RouteCache::GetInstance();
+  std::string server;
+  if (!co_await routes->Resolve(touid, server)) {
+    co_return;
+  }
+  auto self_name = ConfigManager::GetInstance()["SelfServer"]["Name"];
+  for (int attempt = 0;; ++attempt) {
+    bool delivered = false;
+    if (server == self_name) {
+      auto session = UserManager::GetInstance()->GetSession(touid);
+      if (session) {
+        // 在内存中则直接发送通知对方
+        local(session);
+        delivered = true;
+      }
+    } else {
+      delivered = co_await Offload([&]() { return remote(server); });
+    }
+    if (delivered || attempt > 0) {
+      co_return;
+    }
+    // 位置没有变化说明用户确实不在线
+    std::string fresh;
+    if (!co_await routes->Refresh(touid, server, fresh) || fresh == server) {
+      co_return;
+    }
+    server = std::move(fresh);
   }
-  return true;
 }
 
 bool LogicSystem::GetFriendApplyInfo(
@@ -219,237 +268,221 @@ bool LogicSystem::GetFriendApplyInfo(
 
 bool LogicSystem::GetFriendList(
     int self_id, std::vector<std::shared_ptr<UserInfo>>& friend_list) {
-  return MysqlManager::GetInstance()->GetFriendList(self_id, friend_list);
+  std::vector<int> friend_ids;
+  if (!MysqlManager::GetInstance()->GetFriendIds(self_id, friend_ids)) {
+    return false;
+  }
+  // 先查进程内缓存, 剩下的一次批量加载, 不再逐个查询
+  auto cache = UserInfoCache::GetInstance();
+  std::vector<std::shared_ptr<UserInfo>> infos(friend_ids.size());
+  std::vector<int> missing;
+  std::vector<std::size_t> positions;
+  std::vector<uint64_t> epochs;
+  for (std::size_t i = 0; i < friend_ids.size(); ++i) {
+    uint64_t epoch = 0;
+    if (auto cached = cache->Get(friend_ids[i], epoch)) {
+      infos[i] = std::make_shared<UserInfo>(*cached);
+      continue;
+    }
+    missing.push_back(friend_ids[i]);
+    positions.push_back(i);
+    epochs.push_back(epoch);
+  }
+  std::vector<std::shared_ptr<UserInfo>> loaded;
+  ProfileStore::GetInstance()->LoadBatch(missing, loaded);
+  for (std::size_t i = 0; i < loaded.size(); ++i) {
+    if (loaded[i] == nullptr) {
+      continue;
+    }
+    cache->Put(missing[i], *loaded[i], epochs[i]);
+    infos[positions[i]] = std::make_shared<UserInfo>(*loaded[i]);
+  }
+
+  for (auto& info : infos) {
+    if (info == nullptr) {
+      continue;
+    }
+    info->back = info->name;
+    friend_list.push_back(std::move(info));
+  }
+  return true;
 }
 
 void LogicSystem::SearchInfo(std::shared_ptr<CSession> session,
                              const short& msg_id, const std::string& msg_data) {
 }
 
-void LogicSystem::AddFriendApply(std::shared_ptr<CSession> session,
-                                 const short& msg_id,
-                                 const std::string& msg_data) {
-  Json::Reader reader;
-  Json::Value root;
-  reader.parse(msg_data, root);
-  auto uid = root["uid"].asInt();
-  auto applyname = root["applyname"].asString();
-  auto bakname = root["bakname"].asString();
-  auto touid = root["touid"].asInt();
-  std::cout << "user login uid is  " << uid << " applyname  is " << applyname
-            << " bakname is " << bakname << " touid is " << touid << std::endl;
-
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
+net::awaitable<void> LogicSystem::AddFriendApply(
+    std::shared_ptr<CSession> session, uint16_t,
+    std::string_view msg_data) {
+  chat::AddFriendReq req;
+  chat::AddFriendRsp rtvalue;
+  rtvalue.set_error(ErrorCodes::Success);
   Defer defer([this, &rtvalue, session]() {
-    std::string return_str = rtvalue.toStyledString();
-    session->Send(return_str, ID_ADD_FRIEND_RSP);
+    MsgCodec::Send(session, rtvalue, ID_ADD_FRIEND_RSP);
   });
-
-  // 先更新数据库
-  MysqlManager::GetInstance()->AddFriendApply(uid, touid);
-
-  // 查询redis 查找touid对应的server ip
-  auto to_str = std::to_string(touid);
-  auto to_ip_key = kUserIpPrefix + to_str;
-  std::string to_ip_value = "";
-  bool success = RedisManager::GetInstance()->Get(to_ip_key, to_ip_value);
-  if (!success) {
-    return;
+  if (!MsgCodec::Decode(msg_data, req)) {
+    rtvalue.set_error(ErrorCodes::Error_Json);
+    co_return;
   }
 
-  auto& cfg = ConfigManager::GetInstance();
-  auto self_name = cfg["SelfServer"]["Name"];
+  auto uid = req.uid();
+  auto applyname = req.applyname();
+  auto bakname = req.bakname();
+  auto touid = req.touid();
+  std::cout << "user login uid is  " << uid << " applyname  is " << applyname
+            << " bakname is " << bakname << " touid is " << touid << std::endl;
+
+  // 先更新数据库
+  co_await Offload(
+      [&]() { MysqlManager::GetInstance()->AddFriendApply(uid, touid); });
 
-  std::string base_key = kUserBaseInfo + std::to_string(uid);
   auto apply_info = std::make_shared<UserInfo>();
-  bool b_info = GetBaseInfo(base_key, uid, apply_info);
+  bool b_info = co_await LoadBaseInfo(uid, apply_info);
 
   // 直接通知对方有申请消息
-  if (to_ip_value == self_name) {
-    auto session = UserManager::GetInstance()->GetSession(touid);
-    if (session) {
-      // 在内存中则直接发送通知对方
-      Json::Value notify;
-      notify["error"] = ErrorCodes::Success;
-      notify["applyuid"] = uid;
-      notify["name"] = applyname;
-      notify["desc"] = "";
-      if (b_info) {
-        notify["icon"] = apply_info->icon;
-        notify["sex"] = apply_info->sex;
-        notify["nick"] = apply_info->nick;
-      }
-      std::string return_str = notify.toStyledString();
-      session->Send(return_str, ID_NOTIFY_ADD_FRIEND_REQ);
-    }
-
-    return;
-  }
-
-  AddFriendRequest add_request;
-  add_request.set_applyuid(uid);
-  add_request.set_touid(touid);
-  add_request.set_name(applyname);
-  add_request.set_desc("");
-  if (b_info) {
-    add_request.set_icon(apply_info->icon);
-    add_request.set_sex(apply_info->sex);
-    add_request.set_nick(apply_info->nick);
-  }
-
-  // 发送通知
-  ChatGrpcClient::GetInstance()->NotifyAddFriend(to_ip_value, add_request);
+  co_await Deliver(
+      touid,
+      [&](const std::shared_ptr<CSession>& to_session) {
+        chat::AddFriendNotify notify;
+        notify.set_error(ErrorCodes::Success);
+        notify.set_applyuid(uid);
+        notify.set_name(applyname);
+        notify.set_desc("");
+        notify.set_touid(touid);
+        if (b_info) {
+          notify.set_icon(apply_info->icon);
+          notify.set_sex(apply_info->sex);
+          notify.set_nick(apply_info->nick);
+        }
+        MsgCodec::Send(to_session, notify, ID_NOTIFY_ADD_FRIEND_REQ);
+      },
+      [&](const std::string& server) {
+        AddFriendRequest add_request;
+        add_request.set_applyuid(uid);
+        add_request.set_touid(touid);
+        add_request.set_name(applyname);
+        add_request.set_desc("");
+        if (b_info) {
+          add_request.set_icon(apply_info->icon);
+          add_request.set_sex(apply_info->sex);
+          add_request.set_nick(apply_info->nick);
+        }
+        auto rsp = ChatGrpcClient::GetInstance()->NotifyAddFriend(
+            server, add_request);
+        return rsp.error() == ErrorCodes::Success;
+      });
 }
 
-void LogicSystem::AuthFriendApply(std::shared_ptr<CSession> session,
-                                  const short& msg_id,
-                                  const std::string& msg_data) {
-  Json::Reader reader;
-  Json::Value root;
-  reader.parse(msg_data, root);
+net::awaitable<void> LogicSystem::AuthFriendApply(
+    std::shared_ptr<CSession> session, uint16_t,
+    std::string_view msg_data) {
+  chat::AuthFriendReq req;
+  chat::AuthFriendRsp rtvalue;
+  rtvalue.set_error(ErrorCodes::Success);
+  Defer defer([this, &rtvalue, session]() {
+    MsgCodec::Send(session, rtvalue, ID_AUTH_FRIEND_RSP);
+  });
+  if (!MsgCodec::Decode(msg_data, req)) {
+    rtvalue.set_error(ErrorCodes::Error_Json);
+    co_return;
+  }
 
-  auto uid = root["fromuid"].asInt();
-  auto touid = root["touid"].asInt();
-  auto back_name = root["back"].asString();
+  auto uid = req.fromuid();
+  auto touid = req.touid();
+  auto back_name = req.back();
   std::cout << "from " << uid << " auth friend to " << touid << std::endl;
 
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
   auto user_info = std::make_shared<UserInfo>();
-
-  std::string base_key = kUserBaseInfo + std::to_string(touid);
-  bool b_info = GetBaseInfo(base_key, touid, user_info);
+  bool b_info = co_await LoadBaseInfo(touid, user_info);
   if (b_info) {
-    rtvalue["name"] = user_info->name;
-    rtvalue["nick"] = user_info->nick;
-    rtvalue["icon"] = user_info->icon;
-    rtvalue["sex"] = user_info->sex;
-    rtvalue["uid"] = touid;
+    rtvalue.set_name(user_info->name);
+    rtvalue.set_nick(user_info->nick);
+    rtvalue.set_icon(user_info->icon);
+    rtvalue.set_sex(user_info->sex);
+    rtvalue.set_uid(touid);
   } else {
-    rtvalue["error"] = ErrorCodes::UidInvalid;
+    rtvalue.set_error(ErrorCodes::UidInvalid);
   }
 
-  Defer defer([this, &rtvalue, session]() {
-    std::string return_str = rtvalue.toStyledString();
-    session->Send(return_str, ID_AUTH_FRIEND_RSP);
+  co_await Offload([&]() {
+    // 先更新数据库
+    MysqlManager::GetInstance()->AuthFriendApply(uid, touid);
+    // 更新数据库添加好友
+    MysqlManager::GetInstance()->AddFriend(uid, touid, back_name);
   });
 
-  // 先更新数据库
-  MysqlManager::GetInstance()->AuthFriendApply(uid, touid);
-
-  // 更新数据库添加好友
-  MysqlManager::GetInstance()->AddFriend(uid, touid, back_name);
-
-  // 查询redis 查找touid对应的server ip
-  auto to_str = std::to_string(touid);
-  auto to_ip_key = kUserIpPrefix + to_str;
-  std::string to_ip_value = "";
-  bool b_ip = RedisManager::GetInstance()->Get(to_ip_key, to_ip_value);
-  if (!b_ip) {
-    return;
+  // 本服务器上的通知需要申请方的资料, 通常命中进程内缓存.
+  // 发往其它服务器时由对方查询
+  chat::AuthFriendNotify notify;
+  notify.set_error(ErrorCodes::Success);
+  notify.set_fromuid(uid);
+  notify.set_touid(touid);
+  auto from_info = std::make_shared<UserInfo>();
+  if (co_await LoadBaseInfo(uid, from_info)) {
+    notify.set_name(from_info->name);
+    notify.set_nick(from_info->nick);
+    notify.set_icon(from_info->icon);
+    notify.set_sex(from_info->sex);
+  } else {
+    notify.set_error(ErrorCodes::UidInvalid);
   }
 
-  auto& cfg = ConfigManager::GetInstance();
-  auto self_name = cfg["SelfServer"]["Name"];
   // 直接通知对方有认证通过消息
-  if (to_ip_value == self_name) {
-    auto session = UserManager::GetInstance()->GetSession(touid);
-    if (session) {
-      // 在内存中则直接发送通知对方
-      Json::Value notify;
-      notify["error"] = ErrorCodes::Success;
-      notify["fromuid"] = uid;
-      notify["touid"] = touid;
-      std::string base_key = kUserBaseInfo + std::to_string(uid);
-      auto user_info = std::make_shared<UserInfo>();
-      bool b_info = GetBaseInfo(base_key, uid, user_info);
-      if (b_info) {
-        notify["name"] = user_info->name;
-        notify["nick"] = user_info->nick;
-        notify["icon"] = user_info->icon;
-        notify["sex"] = user_info->sex;
-      } else {
-        notify["error"] = ErrorCodes::UidInvalid;
-      }
-
-      std::string return_str = notify.toStyledString();
-      session->Send(return_str, ID_NOTIFY_AUTH_FRIEND_REQ);
-    }
-
-    return;
-  }
-
-  AuthFriendRequest auth_request;
-  auth_request.set_fromuid(uid);
-  auth_request.set_touid(touid);
-
-  // 发送通知
-  ChatGrpcClient::GetInstance()->NotifyAuthFriend(to_ip_value, auth_request);
+  co_await Deliver(
+      touid,
+      [&](const std::shared_ptr<CSession>& to_session) {
+        MsgCodec::Send(to_session, notify, ID_NOTIFY_AUTH_FRIEND_REQ);
+      },
+      [&](const std::string& server) {
+        AuthFriendRequest auth_request;
+        auth_request.set_fromuid(uid);
+        auth_request.set_touid(touid);
+        auto rsp = ChatGrpcClient::GetInstance()->NotifyAuthFriend(
+            server, auth_request);
+        return rsp.error() == ErrorCodes::Success;
+      });
 }
 
-void LogicSystem::DealChatTextMsg(std::shared_ptr<CSession> session,
-                                  const short& msg_id,
-                                  const std::string& msg_data) {
-  Json::Reader reader;
-  Json::Value root;
-  reader.parse(msg_data, root);
-
-  int uid = root["fromid"].asInt();
-  int touid = root["touid"].asInt();
-
-  const Json::Value arrays = root["text_array"];
-
-  Json::Value rtvalue;
-  rtvalue["error"] = ErrorCodes::Success;
-  rtvalue["text_array"] = arrays;
-  rtvalue["fromuid"] = uid;
-  rtvalue["touid"] = touid;
-
+net::awaitable<void> LogicSystem::DealChatTextMsg(
+    std::shared_ptr<CSession> session, uint16_t,
+    std::string_view msg_data) {
+  chat::TextChatReq req;
+  chat::TextChatMsg rtvalue;
   Defer defer([this, &rtvalue, session]() {
-    std::string return_str = rtvalue.toStyledString();
-    session->Send(return_str, ID_TEXT_CHAT_MSG_RSP);
+    MsgCodec::Send(session, rtvalue, ID_TEXT_CHAT_MSG_RSP);
   });
-
-  // 查询redis 查找touid对应的server ip
-  auto to_str = std::to_string(touid);
-  auto to_ip_key = kUserIpPrefix + to_str;
-  std::string to_ip_value = "";
-  bool b_ip = RedisManager::GetInstance()->Get(to_ip_key, to_ip_value);
-  if (!b_ip) {
-    return;
-  }
-
-  auto& cfg = ConfigManager::GetInstance();
-  auto self_name = cfg["SelfServer"]["Name"];
-  // 直接通知对方有消息
-  if (to_ip_value == self_name) {
-    auto session = UserManager::GetInstance()->GetSession(touid);
-    if (session) {
-      // 在内存中则直接发送通知对方
-      std::string return_str = rtvalue.toStyledString();
-      session->Send(return_str, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
-    }
-
-    return;
+  if (!MsgCodec::Decode(msg_data, req)) {
+    rtvalue.set_error(ErrorCodes::Error_Json);
+    co_return;
   }
 
-  TextChatMsgRequest text_msg_req;
-  text_msg_req.set_fromuid(uid);
-  text_msg_req.set_touid(touid);
-  for (const auto& txt_obj : arrays) {
-    auto content = txt_obj["content"].asString();
-    auto msgid = txt_obj["msgid"].asString();
-    std::cout << "content is " << content << std::endl;
-    std::cout << "msgid is " << msgid << std::endl;
-    auto* text_msg = text_msg_req.add_textmsgs();
-    text_msg->set_msgid(msgid);
-    text_msg->set_msgcontent(content);
-  }
+  int uid = req.fromid();
+  int touid = req.touid();
+  rtvalue.set_error(ErrorCodes::Success);
+  rtvalue.set_fromuid(uid);
+  rtvalue.set_touid(touid);
+  *rtvalue.mutable_text_array() = req.text_array();
 
-  // 发送通知
-  ChatGrpcClient::GetInstance()->NotifyTextChatMsg(to_ip_value, text_msg_req,
-                                                   rtvalue);
+  // 直接通知对方有消息
+  co_await Deliver(
+      touid,
+      [&](const std::shared_ptr<CSession>& to_session) {
+        MsgCodec::Send(to_session, rtvalue, ID_NOTIFY_TEXT_CHAT_MSG_REQ);
+      },
+      [&](const std::string& server) {
+        TextChatMsgRequest text_msg_req;
+        text_msg_req.set_fromuid(uid);
+        text_msg_req.set_touid(touid);
+        for (const auto& txt_obj : rtvalue.text_array()) {
+          auto* text_msg = text_msg_req.add_textmsgs();
+          text_msg->set_msgid(txt_obj.msgid());
+          text_msg->set_msgcontent(txt_obj.content());
+        }
+        auto rsp = ChatGrpcClient::GetInstance()->NotifyTextChatMsg(
+            server, text_msg_req);
+        return rsp.error() == ErrorCodes::Success;
+      });
 }
 
 bool LogicSystem::IsPureDigit(const std::string& str) {
@@ -0,0 +1,138 @@
+#include "LogicWorker.hpp"
+
+#include "CSession.hpp"
+#include "Metrics.hpp"
+
+namespace {
+// DrainRing一次最多取出的消息数, 取满后重新投递自己, 让已经在运行的
+// 处理协程有机会执行
+const std::size_t kDrainBatch = 64;
+}  // namespace
+
+LogicWorker::LogicWorker(std::size_t index, LogicHandler handler)
+    : handler_(std::move(handler)),
+      work_(net::make_work_guard(ioc_)),
+      ring_(kMaxRecvQue),
+      drain_scheduled_(false),
+      depth_(Metrics::GetInstance()->Counter("logic.worker" +
+                                             std::to_string(index) + ".depth")),
+      handled_(Metrics::GetInstance()->Counter(
+          "logic.worker" + std::to_string(index) + ".handled")),
+      full_(Metrics::GetInstance()->Counter(
+          "logic.worker" + std::to_string(index) + ".full")),
+      active_(Metrics::GetInstance()->Counter(
+          "logic.worker" + std::to_string(index) + ".active")),
+      has_waiters_(false) {
+  thread_ = std::thread([this]() { ioc_.run(); });
+}
+
+LogicWorker::~LogicWorker() { Stop(); }
+
+bool LogicWorker::Post(std::shared_ptr<LogicNode> msg) {
+  if (!ring_.TryPush(std::move(msg))) {
+    full_++;
+    return false;
+  }
+  depth_++;
+  // worker正在取队列时不需要再唤醒, 省掉每条消息一次的post
+  if (!drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+    net::post(ioc_, [this]() { DrainRing(); });
+  }
+  return true;
+}
+
+void LogicWorker::WaitForSpace(std::shared_ptr<CSession> session) {
+  {
+    std::lock_guard<std::mutex> lock(waiters_mtx_);
+    waiters_.push_back(std::move(session));
+    has_waiters_.store(true, std::memory_order_relaxed);
+  }
+  // 与NotifyWaiters中的屏障配对: 调用方随后的Post看不到worker取走的槽位
+  // 时, worker取完之后一定能看到这次登记
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+int64_t LogicWorker::Depth() const {
+  return depth_.load(std::memory_order_relaxed);
+}
+
+void LogicWorker::Stop() {
+  // 不再保持io_context, 已投递的消息和进行中的协程全部结束后run返回
+  work_.reset();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void LogicWorker::DrainRing() {
+  std::shared_ptr<LogicNode> batch[kDrainBatch];
+  std::size_t count = ring_.PopBatch(batch, kDrainBatch);
+  for (std::size_t i = 0; i < count; ++i) {
+    Enqueue(std::move(batch[i]));
+  }
+  if (count > 0) {
+    NotifyWaiters();
+  }
+  if (count == kDrainBatch) {
+    net::post(ioc_, [this]() { DrainRing(); });
+    return;
+  }
+  // 清除标记后再检查一次, 避免与刚入队的生产者互相错过
+  drain_scheduled_.exchange(false, std::memory_order_acq_rel);
+  if (ring_.Empty() ||
+      drain_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  net::post(ioc_, [this]() { DrainRing(); });
+}
+
+void LogicWorker::Enqueue(std::shared_ptr<LogicNode> msg) {
+  auto* key = msg->session_.get();
+  auto it = inboxes_.find(key);
+  if (it != inboxes_.end()) {
+    // 该session已有协程在处理, 排在它后面
+    it->second.push(std::move(msg));
+    return;
+  }
+  inboxes_[key].push(std::move(msg));
+  active_++;
+  net::co_spawn(ioc_, Drain(key), net::detached);
+}
+
+void LogicWorker::NotifyWaiters() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!has_waiters_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  std::vector<std::shared_ptr<CSession>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(waiters_mtx_);
+    waiters.swap(waiters_);
+    has_waiters_.store(false, std::memory_order_relaxed);
+  }
+  for (auto& session : waiters) {
+    session->OnLogicSpace();
+  }
+}
+
+net::awaitable<void> LogicWorker::Drain(CSession* key) {
+  while (true) {
+    auto it = inboxes_.find(key);
+    if (it->second.empty()) {
+      inboxes_.erase(it);
+      active_--;
+      co_return;
+    }
+    auto msg = std::move(it->second.front());
+    it->second.pop();
+    depth_--;
+    auto session = msg->session_;
+    try {
+      co_await handler_(std::move(msg));
+    } catch (std::exception& e) {
+      std::cout << "logic handler exception is " << e.what() << std::endl;
+    }
+    handled_++;
+    session->OnLogicDone();
+  }
+}
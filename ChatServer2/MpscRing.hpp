@@ -0,0 +1,87 @@
+#pragma once
+#include "utilities.hpp"
+
+// 有界多生产者单消费者环形队列(Vyukov). 每个槽位带序号, 生产者用CAS抢占
+// 写入位置, 写完后发布序号; 消费者按序号判断槽位是否就绪, 可以一次取出一批.
+// 容量向上取整为2的幂, 队列满时TryPush返回false
+template <typename T>
+class MpscRing {
+ public:
+  explicit MpscRing(std::size_t capacity) : head_(0), tail_(0) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    for (std::size_t i = 0; i < size; ++i) {
+      slots_[i].seq_.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  bool TryPush(T&& value) {
+    std::size_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      std::size_t seq = slot->seq_.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // 消费者还没取走一圈之前的数据, 队列已满
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value_ = std::move(value);
+    slot->seq_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 只能由唯一的消费者线程调用, 队列为空或者下一个槽位的生产者尚未写完时
+  // 返回false
+  bool Pop(T& value) {
+    Slot& slot = slots_[tail_ & mask_];
+    if (slot.seq_.load(std::memory_order_acquire) != tail_ + 1) {
+      return false;
+    }
+    value = std::move(slot.value_);
+    slot.seq_.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+  }
+
+  // 最多取出max_count个, 返回实际取出的个数
+  std::size_t PopBatch(T* values, std::size_t max_count) {
+    std::size_t count = 0;
+    while (count < max_count && Pop(values[count])) {
+      ++count;
+    }
+    return count;
+  }
+
+  bool Empty() const {
+    return slots_[tail_ & mask_].seq_.load(std::memory_order_acquire) !=
+           tail_ + 1;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<std::size_t> seq_;
+    T value_;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t mask_;
+  // 生产者和消费者的位置分开缓存行, 避免伪共享
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::size_t tail_;
+};
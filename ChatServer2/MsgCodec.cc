@@ -0,0 +1,66 @@
+#include "MsgCodec.hpp"
+
+#include <google/protobuf/util/json_util.h>
+
+#include "BufferPool.hpp"
+#include "CSession.hpp"
+#include "JsonWriter.hpp"
+#include "MsgNode.hpp"
+
+bool MsgCodec::IsJson(const char* data, std::size_t len) {
+  for (std::size_t i = 0; i < len; ++i) {
+    if (!std::isspace(static_cast<unsigned char>(data[i]))) {
+      return data[i] == '{';
+    }
+  }
+  return false;
+}
+
+bool MsgCodec::Decode(const char* data, std::size_t len,
+                      google::protobuf::Message& msg) {
+  if (!IsJson(data, len)) {
+    return msg.ParseFromArray(data, len);
+  }
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  auto status = google::protobuf::util::JsonStringToMessage(
+      google::protobuf::StringPiece(data, len), &msg, options);
+  if (!status.ok()) {
+    std::cout << "Decode json failed, error is " << status.ToString()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool MsgCodec::Decode(std::string_view data,
+                      google::protobuf::Message& msg) {
+  return Decode(data.data(), data.size(), msg);
+}
+
+std::shared_ptr<SendNode> MsgCodec::Encode(
+    int codec, const google::protobuf::Message& msg, short msg_id) {
+  if (codec == kCodecProtobuf) {
+    auto node = MakePooled<SendNode>(msg.ByteSizeLong(), msg_id);
+    msg.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t*>(node->Body()));
+    return node;
+  }
+
+  // json先写入线程内复用的缓冲区, 再拷贝进内存池分配的发送节点
+  thread_local std::string json_buf;
+  json_buf.clear();
+  if (!JsonWriter::Write(msg, json_buf)) {
+    json_buf.clear();
+    google::protobuf::util::JsonPrintOptions options;
+    options.always_print_primitive_fields = true;
+    options.preserve_proto_field_names = true;
+    google::protobuf::util::MessageToJsonString(msg, &json_buf, options);
+  }
+  return MakePooled<SendNode>(json_buf.data(), json_buf.size(), msg_id);
+}
+
+void MsgCodec::Send(const std::shared_ptr<CSession>& session,
+                    const google::protobuf::Message& msg, short msg_id) {
+  session->Send(Encode(session->GetCodec(), msg, msg_id));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <google/protobuf/message.h>
+
+#include "chat.pb.h"
+#include "utilities.hpp"
+
+class CSession;
+class SendNode;
+
+// 客户端消息体在json和protobuf两种编码与protobuf消息之间的转换
+class MsgCodec {
+ public:
+  // 第一个非空白字符为'{'的消息体按json处理, protobuf消息不会以该字节开头
+  static bool IsJson(const char* data, std::size_t len);
+  static bool Decode(const char* data, std::size_t len,
+                     google::protobuf::Message& msg);
+  static bool Decode(std::string_view data, google::protobuf::Message& msg);
+  // protobuf直接序列化进发送节点, json输出紧凑格式
+  static std::shared_ptr<SendNode> Encode(int codec,
+                                          const google::protobuf::Message& msg,
+                                          short msg_id);
+  // 按目标session协商的编码发送
+  static void Send(const std::shared_ptr<CSession>& session,
+                   const google::protobuf::Message& msg, short msg_id);
+};
@@ -1,29 +1,94 @@
 #include "MsgNode.hpp"
 
-MsgNode::MsgNode(short max_len) : total_len_(max_len), curr_len_(0) {
-  data_ = new char[total_len_ + 1]();
+#include "BufferPool.hpp"
+
+MsgNode::MsgNode(uint32_t max_len) : total_len_(max_len), curr_len_(0) {
+  data_ = BufferPool::Allocate(total_len_ + 1);
   data_[total_len_] = '\0';
 }
 
-MsgNode::~MsgNode() { delete[] data_; }
+MsgNode::MsgNode(std::string&& buffer)
+    : curr_len_(0), total_len_(buffer.size()), adopted_(std::move(buffer)) {
+  data_ = adopted_.data();
+}
+
+MsgNode::~MsgNode() {
+  if (adopted_.empty()) {
+    BufferPool::Deallocate(data_, total_len_ + 1);
+  }
+}
 
 void MsgNode::Clear() {
   ::memset(data_, 0, total_len_);
   curr_len_ = 0;
 }
 
-RecvNode::RecvNode(short max_len, short msg_id)
-    : MsgNode(max_len), msg_id_(msg_id) {}
+RecvNode::RecvNode(uint32_t max_len, short msg_id)
+    : MsgNode(max_len), msg_id_(msg_id), flags_(0) {}
 
-SendNode::SendNode(const char* msg, short max_len, short msg_id)
-    : MsgNode(max_len + kHeadTotalLen), msg_id_(msg_id) {
-  // 先发送id, 转为网络字节序
-  short msg_id_host =
-      boost::asio::detail::socket_ops::host_to_network_short(msg_id);
-  memcpy(data_, &msg_id_host, kHeadIdLen);
+SendNode::SendNode(const char* msg, uint32_t max_len, short msg_id)
+    : MsgNode(max_len + kSendHeadRoom),
+      msg_id_(msg_id),
+      switch_version_(0),
+      body_len_(max_len),
+      flags_(0) {
+  memcpy(data_ + kSendHeadRoom, msg, max_len);
+}
+
+SendNode::SendNode(uint32_t body_len, short msg_id)
+    : MsgNode(body_len + kSendHeadRoom),
+      msg_id_(msg_id),
+      switch_version_(0),
+      body_len_(body_len),
+      flags_(0) {}
+
+SendNode::SendNode(std::string&& framed, short msg_id)
+    : MsgNode(std::move(framed)),
+      msg_id_(msg_id),
+      switch_version_(0),
+      body_len_(0),
+      flags_(0) {
+  assert(total_len_ >= kSendHeadRoom);
+  body_len_ = total_len_ - kSendHeadRoom;
+}
+
+std::shared_ptr<SendNode> SendNode::Adopt(std::string&& framed,
+                                          short msg_id) {
+  return MakePooled<SendNode>(std::move(framed), msg_id);
+}
+
+char* SendNode::Body() { return data_ + kSendHeadRoom; }
+
+uint32_t SendNode::BodyLen() const { return body_len_; }
+
+bool SendNode::Frame(int version, net::const_buffer& buffer) {
+  uint32_t body_len = BodyLen();
   // 转为网络字节序
-  short max_len_host =
-      boost::asio::detail::socket_ops::host_to_network_short(max_len);
-  memcpy(data_ + kHeadIdLen, &max_len_host, kHeadDataLen);
-  memcpy(data_ + kHeadTotalLen, msg, max_len);
-}
\ No newline at end of file
+  uint16_t msg_id_net =
+      boost::asio::detail::socket_ops::host_to_network_short(msg_id_);
+  if (version == kProtocolV2) {
+    // v2: id(2) + flags(2) + len(4)
+    char* head = data_ + kSendHeadRoom - kHeadTotalLenV2;
+    uint16_t flags_net =
+        boost::asio::detail::socket_ops::host_to_network_short(flags_);
+    uint32_t len_net =
+        boost::asio::detail::socket_ops::host_to_network_long(body_len);
+    memcpy(head, &msg_id_net, kHeadIdLen);
+    memcpy(head + kHeadIdLen, &flags_net, kHeadFlagsLen);
+    memcpy(head + kHeadIdLen + kHeadFlagsLen, &len_net, kHeadDataLenV2);
+    buffer = net::buffer(head, kHeadTotalLenV2 + body_len);
+    return true;
+  }
+
+  // v1: id(2) + len(2), 不能携带flags
+  if (body_len > 0x7fff || flags_ != 0) {
+    return false;
+  }
+  char* head = data_ + kSendHeadRoom - kHeadTotalLen;
+  uint16_t len_net =
+      boost::asio::detail::socket_ops::host_to_network_short(body_len);
+  memcpy(head, &msg_id_net, kHeadIdLen);
+  memcpy(head + kHeadIdLen, &len_net, kHeadDataLen);
+  buffer = net::buffer(head, kHeadTotalLen + body_len);
+  return true;
+}
@@ -2,35 +2,72 @@
 
 #include "utilities.hpp"
 
+class CSession;
+class Compressor;
 class LogicSystem;
 
 class MsgNode {
  public:
-  MsgNode(short max_len);
+  MsgNode(uint32_t max_len);
   ~MsgNode();
+  MsgNode(const MsgNode&) = delete;
+  MsgNode& operator=(const MsgNode&) = delete;
   void Clear();
 
-  short curr_len_;
-  short total_len_;
+  uint32_t curr_len_;
+  uint32_t total_len_;
   char* data_;
+
+ protected:
+  // 接管调用方已经序列化好的缓冲区, 不从内存池分配
+  explicit MsgNode(std::string&& buffer);
+
+ private:
+  // 非空时data_指向该字符串内部, 析构时不归还内存池
+  std::string adopted_;
 };
 
 class RecvNode : public MsgNode {
+  friend class CSession;
+  friend class Compressor;
   friend class LogicSystem;
 
  public:
-  RecvNode(short max_len, short msg_id);
+  RecvNode(uint32_t max_len, short msg_id);
 
  private:
   short msg_id_;
+  // v2消息头中的flags
+  uint16_t flags_;
 };
 
+// 消息体前预留kSendHeadRoom字节, 真正发送时才按session当前的协议版本写入消息头
 class SendNode : public MsgNode {
+  friend class CSession;
+  friend class Compressor;
   friend class LogicSystem;
 
  public:
-  SendNode(const char* msg, short max_len, short msg_id);
+  SendNode(const char* msg, uint32_t max_len, short msg_id);
+  // 只分配消息体空间, 由调用方通过Body()直接写入
+  SendNode(uint32_t body_len, short msg_id);
+  // framed的前kSendHeadRoom字节为预留的消息头, 之后是消息体, 整体接管不拷贝
+  SendNode(std::string&& framed, short msg_id);
+
+  static std::shared_ptr<SendNode> Adopt(std::string&& framed, short msg_id);
+
+  char* Body();
+  uint32_t BodyLen() const;
 
  private:
+  // 按协议版本写入消息头, 消息体超出该版本长度上限时返回false
+  bool Frame(int version, net::const_buffer& buffer);
+
   short msg_id_;
-};
\ No newline at end of file
+  // 非0时表示这条消息发出之后, 后续消息改用该协议版本
+  int switch_version_;
+  // 实际消息体长度, 压缩后可能小于分配的空间
+  uint32_t body_len_;
+  // 写入v2消息头的flags, v1消息头无法携带
+  uint16_t flags_;
+};
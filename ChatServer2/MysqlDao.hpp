@@ -54,12 +54,17 @@ class MysqlDao {
   bool GetApplyList(int to_uid,
                     std::vector<std::shared_ptr<ApplyInfo>>& applyList,
                     int begin, int limit);
-  bool GetFriendList(int self_id,
-                     std::vector<std::shared_ptr<UserInfo>>& user_info_list);
+  // 按uid批量查询, 不存在的uid没有对应结果, 结果的顺序不确定
+  bool GetUsers(const std::vector<int>& uids,
+                std::vector<std::shared_ptr<UserInfo>>& users);
+  // 只返回好友的uid, 资料由调用方批量加载
+  bool GetFriendIds(int self_id, std::vector<int>& friend_ids);
   bool AddFriendApply(const int& from, const int& to);
   bool AuthFriendApply(const int& from, const int& to);
   bool AddFriend(const int& from, const int& to, std::string back_name);
 
  private:
+  // 一条IN查询最多带的uid数
+  static const std::size_t kMaxInList = 500;
   std::unique_ptr<MysqlPool> pool_;
 };
\ No newline at end of file
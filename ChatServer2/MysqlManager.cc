@@ -38,9 +38,13 @@ bool MysqlManager::GetApplyList(
   return dao_.GetApplyList(touid, applyList, begin, limit);
 }
 
-bool MysqlManager::GetFriendList(
-    int self_id, std::vector<std::shared_ptr<UserInfo>>& user_info_list) {
-  return dao_.GetFriendList(self_id, user_info_list);
+bool MysqlManager::GetUsers(const std::vector<int>& uids,
+                            std::vector<std::shared_ptr<UserInfo>>& users) {
+  return dao_.GetUsers(uids, users);
+}
+
+bool MysqlManager::GetFriendIds(int self_id, std::vector<int>& friend_ids) {
+  return dao_.GetFriendIds(self_id, friend_ids);
 }
 
 bool MysqlManager::AddFriendApply(const int& from, const int& to) {
@@ -25,8 +25,9 @@ class MysqlManager : public Singleton<MysqlManager> {
   bool GetApplyList(int touid,
                     std::vector<std::shared_ptr<ApplyInfo>>& applyList,
                     int begin, int limit = 10);
-  bool GetFriendList(int self_id,
-                     std::vector<std::shared_ptr<UserInfo>>& user_info_list);
+  bool GetUsers(const std::vector<int>& uids,
+                std::vector<std::shared_ptr<UserInfo>>& users);
+  bool GetFriendIds(int self_id, std::vector<int>& friend_ids);
   bool AddFriendApply(const int& from, const int& to);
   bool AuthFriendApply(const int& from, const int& to);
   bool AddFriend(const int& from, const int& to, std::string back_name);
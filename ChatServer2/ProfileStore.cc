@@ -0,0 +1,120 @@
+#include "ProfileStore.hpp"
+
+#include "ConfigManager.hpp"
+#include "Metrics.hpp"
+#include "MysqlManager.hpp"
+#include "RedisManager.hpp"
+#include "profile.pb.h"
+
+namespace {
+const int kDefaultTtlSec = 86400;
+}  // namespace
+
+ProfileStore::ProfileStore()
+    : redis_hits_(Metrics::GetInstance()->Counter("profile.redis_hits")),
+      redis_misses_(Metrics::GetInstance()->Counter("profile.redis_misses")),
+      db_loads_(Metrics::GetInstance()->Counter("profile.db_loads")) {
+  auto ttl = ConfigManager::GetInstance()["Redis"]["ProfileTtlSec"];
+  ttl_sec_ = ttl.empty() ? kDefaultTtlSec : std::stoi(ttl);
+}
+
+std::string ProfileStore::Encode(const UserInfo& info) {
+  chat::UserProfile profile;
+  profile.set_uid(info.uid);
+  profile.set_name(info.name);
+  profile.set_pwd(info.pwd);
+  profile.set_email(info.email);
+  profile.set_nick(info.nick);
+  profile.set_desc(info.desc);
+  profile.set_sex(info.sex);
+  profile.set_icon(info.icon);
+  return profile.SerializeAsString();
+}
+
+bool ProfileStore::Decode(int uid, const std::string& value, UserInfo& info) {
+  chat::UserProfile profile;
+  // json文本以'{'开头, 不是合法的protobuf编码; uid不符也当作无效
+  if (!profile.ParseFromString(value) || profile.uid() != uid) {
+    return false;
+  }
+  info.uid = profile.uid();
+  info.name = profile.name();
+  info.pwd = profile.pwd();
+  info.email = profile.email();
+  info.nick = profile.nick();
+  info.desc = profile.desc();
+  info.sex = profile.sex();
+  info.icon = profile.icon();
+  return true;
+}
+
+bool ProfileStore::Load(int uid, UserInfo& info) {
+  std::string key = kUserBaseInfo + std::to_string(uid);
+  std::string value;
+  if (RedisManager::GetInstance()->Get(key, value) &&
+      Decode(uid, value, info)) {
+    redis_hits_++;
+    return true;
+  }
+  redis_misses_++;
+  // redis没有则查数据库
+  db_loads_++;
+  auto user = MysqlManager::GetInstance()->GetUser(uid);
+  if (user == nullptr) {
+    return false;
+  }
+  info = *user;
+  // 将数据库内容写入redis缓存
+  RedisManager::GetInstance()->SetEx(key, Encode(info), ttl_sec_);
+  return true;
+}
+
+void ProfileStore::LoadBatch(const std::vector<int>& uids,
+                             std::vector<std::shared_ptr<UserInfo>>& infos) {
+  infos.assign(uids.size(), nullptr);
+  if (uids.empty()) {
+    return;
+  }
+  std::vector<std::string> keys;
+  keys.reserve(uids.size());
+  for (int uid : uids) {
+    keys.push_back(kUserBaseInfo + std::to_string(uid));
+  }
+  // redis不可用时values全为空, 全部查数据库
+  std::vector<std::optional<std::string>> values;
+  RedisManager::GetInstance()->MGet(keys, values);
+
+  // 未命中的uid到它在uids中的位置, 同一个uid可能出现多次
+  std::unordered_multimap<int, std::size_t> missing;
+  std::vector<int> missing_uids;
+  for (std::size_t i = 0; i < uids.size(); ++i) {
+    auto info = std::make_shared<UserInfo>();
+    if (values[i] && Decode(uids[i], *values[i], *info)) {
+      infos[i] = std::move(info);
+      continue;
+    }
+    if (missing.count(uids[i]) == 0) {
+      missing_uids.push_back(uids[i]);
+    }
+    missing.emplace(uids[i], i);
+  }
+  redis_hits_ += static_cast<int64_t>(uids.size() - missing.size());
+  redis_misses_ += static_cast<int64_t>(missing.size());
+  if (missing_uids.empty()) {
+    return;
+  }
+
+  db_loads_ += static_cast<int64_t>(missing_uids.size());
+  std::vector<std::shared_ptr<UserInfo>> users;
+  MysqlManager::GetInstance()->GetUsers(missing_uids, users);
+  std::vector<std::pair<std::string, std::string>> kvs;
+  kvs.reserve(users.size());
+  for (auto& user : users) {
+    auto range = missing.equal_range(user->uid);
+    for (auto it = range.first; it != range.second; ++it) {
+      infos[it->second] = user;
+    }
+    kvs.emplace_back(kUserBaseInfo + std::to_string(user->uid), Encode(*user));
+  }
+  RedisManager::GetInstance()->MSetEx(kvs, ttl_sec_);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Singleton.hpp"
+#include "data.hpp"
+#include "utilities.hpp"
+
+// 用户资料在redis中的缓存. ubaseinfo_<uid>保存chat.UserProfile的二进制
+// 编码, 带过期时间, 长期不活跃的用户自然淘汰. 读到无法解析的值(旧的json
+// 格式)按未命中处理, 从数据库重新加载并覆盖.
+// 不查进程内的UserInfoCache, 由调用方处理
+class ProfileStore : public Singleton<ProfileStore> {
+  friend class Singleton<ProfileStore>;
+
+ public:
+  ~ProfileStore() {}
+
+  // 先查redis, 没有则查数据库并写回redis. 用户不存在时返回false
+  bool Load(int uid, UserInfo& info);
+  // 批量加载, 一次MGET取回, 未命中的一条IN查询读数据库, 再流水线写回.
+  // infos与uids一一对应, 不存在的用户为nullptr
+  void LoadBatch(const std::vector<int>& uids,
+                 std::vector<std::shared_ptr<UserInfo>>& infos);
+
+  static std::string Encode(const UserInfo& info);
+  static bool Decode(int uid, const std::string& value, UserInfo& info);
+
+ private:
+  ProfileStore();
+
+  int ttl_sec_;
+  std::atomic<int64_t>& redis_hits_;
+  std::atomic<int64_t>& redis_misses_;
+  std::atomic<int64_t>& db_loads_;
+};
@@ -0,0 +1,458 @@
+#include "RedisAsyncClient.hpp"
+
+#include <hiredis/async.h>
+
+#include "ConfigManager.hpp"
+#include "Metrics.hpp"
+
+namespace {
+const std::size_t kDefaultConnections = 2;
+const int kReconnectMs = 1000;
+
+struct RedisCommand {
+  std::vector<std::string> args_;
+  std::unique_ptr<RedisPending> op_;
+};
+
+RedisReply ToReply(const redisReply* reply) {
+  RedisReply result;
+  result.type_ = reply->type;
+  result.integer_ = reply->integer;
+  if (reply->str != nullptr) {
+    result.str_.assign(reply->str, reply->len);
+  }
+  result.elements_.reserve(reply->elements);
+  for (std::size_t i = 0; i < reply->elements; ++i) {
+    result.elements_.push_back(ToReply(reply->element[i]));
+  }
+  return result;
+}
+
+void Finish(std::unique_ptr<RedisPending> op, boost::system::error_code ec,
+            RedisReply reply) {
+  static auto& inflight =
+      Metrics::GetInstance()->Counter("redis.async.inflight");
+  static auto& failed = Metrics::GetInstance()->Counter("redis.async.failed");
+  inflight--;
+  if (ec) {
+    failed++;
+  }
+  op->Complete(ec, std::move(reply));
+}
+}  // namespace
+
+// 一条hiredis异步连接, 把hiredis的读写事件挂到asio的描述符等待上.
+// 除Push和Connected外只在redis线程调用
+class RedisAsyncConnection
+    : public std::enable_shared_from_this<RedisAsyncConnection> {
+ public:
+  RedisAsyncConnection(net::io_context& ioc, std::string host, int port)
+      : ioc_(ioc),
+        host_(std::move(host)),
+        port_(port),
+        ctx_(nullptr),
+        generation_(0),
+        want_read_(false),
+        want_write_(false),
+        read_waiting_(false),
+        write_waiting_(false),
+        closed_(false),
+        connected_(false),
+        reconnect_pending_(false),
+        reconnect_timer_(ioc),
+        flush_scheduled_(false) {}
+
+  void Connect();
+  // 释放连接, 之后不再重连
+  void Close();
+  bool Connected() const { return connected_; }
+  // 任意线程调用, 同一次唤醒前积累的命令一起交给hiredis
+  void Push(RedisCommand cmd);
+  // 添加订阅, 尚未连接时发起连接
+  void AddSubscription(RedisSubscription subscription);
+
+ private:
+  void Flush();
+  void ScheduleReconnect();
+  void WaitRead();
+  void WaitWrite();
+  void SendSubscribe(RedisSubscription* subscription);
+
+  // hiredis的事件钩子, data为连接自身
+  static void AddRead(void* data);
+  static void DelRead(void* data);
+  static void AddWrite(void* data);
+  static void DelWrite(void* data);
+  static void Cleanup(void* data);
+  static void OnConnect(const redisAsyncContext* ac, int status);
+  static void OnDisconnect(const redisAsyncContext* ac, int status);
+  static void OnReply(redisAsyncContext* ac, void* reply, void* privdata);
+  static void OnMessage(redisAsyncContext* ac, void* reply, void* privdata);
+
+  net::io_context& ioc_;
+  std::string host_;
+  int port_;
+  redisAsyncContext* ctx_;
+  std::unique_ptr<net::posix::stream_descriptor> socket_;
+  // 每次建立连接加一, 旧连接上残留的等待回调据此忽略
+  uint64_t generation_;
+  // hiredis当前是否需要读写事件
+  bool want_read_;
+  bool want_write_;
+  // 是否已经发起了描述符等待
+  bool read_waiting_;
+  bool write_waiting_;
+  bool closed_;
+  std::atomic<bool> connected_;
+  bool reconnect_pending_;
+  net::steady_timer reconnect_timer_;
+  // 连接建立后逐个重新订阅
+  std::vector<std::unique_ptr<RedisSubscription>> subscriptions_;
+  std::mutex mtx_;
+  std::vector<RedisCommand> queue_;
+  bool flush_scheduled_;
+};
+
+void RedisAsyncConnection::Connect() {
+  if (closed_) {
+    return;
+  }
+  auto* ac = redisAsyncConnect(host_.c_str(), port_);
+  if (ac == nullptr || ac->err != 0) {
+    std::cout << "redis async connect failed, error is "
+              << (ac == nullptr ? "alloc failed" : ac->errstr) << std::endl;
+    if (ac != nullptr) {
+      redisAsyncFree(ac);
+    }
+    ScheduleReconnect();
+    return;
+  }
+  ctx_ = ac;
+  ++generation_;
+  want_read_ = false;
+  want_write_ = false;
+  read_waiting_ = false;
+  write_waiting_ = false;
+  // 描述符归hiredis所有, 释放时只解除关联不关闭
+  socket_ = std::make_unique<net::posix::stream_descriptor>(ioc_, ac->c.fd);
+  ac->data = this;
+  ac->ev.data = this;
+  ac->ev.addRead = &RedisAsyncConnection::AddRead;
+  ac->ev.delRead = &RedisAsyncConnection::DelRead;
+  ac->ev.addWrite = &RedisAsyncConnection::AddWrite;
+  ac->ev.delWrite = &RedisAsyncConnection::DelWrite;
+  ac->ev.cleanup = &RedisAsyncConnection::Cleanup;
+  ac->ev.scheduleTimer = nullptr;
+  // 设置连接回调时hiredis会注册写事件, 钩子必须先挂好
+  redisAsyncSetConnectCallback(ac, &RedisAsyncConnection::OnConnect);
+  redisAsyncSetDisconnectCallback(ac, &RedisAsyncConnection::OnDisconnect);
+  // 连接建立前hiredis先缓存命令
+  for (auto& subscription : subscriptions_) {
+    SendSubscribe(subscription.get());
+  }
+}
+
+void RedisAsyncConnection::Close() {
+  closed_ = true;
+  reconnect_timer_.cancel();
+  if (ctx_ != nullptr) {
+    // 未收到回复的命令以空回复回调, 随后调用Cleanup
+    redisAsyncFree(ctx_);
+  }
+  Flush();
+}
+
+void RedisAsyncConnection::Push(RedisCommand cmd) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    queue_.push_back(std::move(cmd));
+    if (flush_scheduled_) {
+      return;
+    }
+    flush_scheduled_ = true;
+  }
+  net::post(ioc_, [self = shared_from_this()]() { self->Flush(); });
+}
+
+void RedisAsyncConnection::AddSubscription(RedisSubscription subscription) {
+  subscriptions_.push_back(
+      std::make_unique<RedisSubscription>(std::move(subscription)));
+  if (ctx_ != nullptr) {
+    SendSubscribe(subscriptions_.back().get());
+  } else if (!reconnect_pending_) {
+    Connect();
+  }
+}
+
+void RedisAsyncConnection::SendSubscribe(RedisSubscription* subscription) {
+  const char* argv[] = {"SUBSCRIBE", subscription->channel_.data()};
+  std::size_t argvlen[] = {9, subscription->channel_.size()};
+  redisAsyncCommandArgv(ctx_, &RedisAsyncConnection::OnMessage, subscription,
+                        2, argv, argvlen);
+}
+
+void RedisAsyncConnection::Flush() {
+  static auto& batches = Metrics::GetInstance()->Counter("redis.async.batches");
+  std::vector<RedisCommand> batch;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    batch.swap(queue_);
+    flush_scheduled_ = false;
+  }
+  if (batch.empty()) {
+    return;
+  }
+  batches++;
+  // hiredis只把命令追加到输出缓冲并注册写事件, 整批在下一次可写时写出
+  std::vector<const char*> argv;
+  std::vector<std::size_t> argvlen;
+  for (auto& cmd : batch) {
+    if (ctx_ == nullptr) {
+      Finish(std::move(cmd.op_), net::error::not_connected, RedisReply());
+      continue;
+    }
+    argv.clear();
+    argvlen.clear();
+    for (auto& arg : cmd.args_) {
+      argv.push_back(arg.data());
+      argvlen.push_back(arg.size());
+    }
+    auto* op = cmd.op_.release();
+    if (redisAsyncCommandArgv(ctx_, &RedisAsyncConnection::OnReply, op,
+                              static_cast<int>(argv.size()), argv.data(),
+                              argvlen.data()) != REDIS_OK) {
+      Finish(std::unique_ptr<RedisPending>(op), net::error::not_connected,
+             RedisReply());
+    }
+  }
+}
+
+void RedisAsyncConnection::ScheduleReconnect() {
+  static auto& reconnects =
+      Metrics::GetInstance()->Counter("redis.async.reconnects");
+  if (closed_) {
+    return;
+  }
+  reconnects++;
+  reconnect_pending_ = true;
+  reconnect_timer_.expires_after(std::chrono::milliseconds(kReconnectMs));
+  reconnect_timer_.async_wait(
+      [self = shared_from_this()](boost::system::error_code ec) {
+        if (!ec) {
+          self->reconnect_pending_ = false;
+          self->Connect();
+        }
+      });
+}
+
+void RedisAsyncConnection::WaitRead() {
+  read_waiting_ = true;
+  socket_->async_wait(
+      net::posix::stream_descriptor::wait_read,
+      [self = shared_from_this(),
+       generation = generation_](boost::system::error_code ec) {
+        if (generation != self->generation_) {
+          return;
+        }
+        self->read_waiting_ = false;
+        if (ec || self->ctx_ == nullptr || !self->want_read_) {
+          return;
+        }
+        // 处理回复时连接可能被释放, 释放后ctx_为空
+        redisAsyncHandleRead(self->ctx_);
+        if (self->ctx_ != nullptr && self->want_read_ &&
+            !self->read_waiting_) {
+          self->WaitRead();
+        }
+      });
+}
+
+void RedisAsyncConnection::WaitWrite() {
+  write_waiting_ = true;
+  socket_->async_wait(
+      net::posix::stream_descriptor::wait_write,
+      [self = shared_from_this(),
+       generation = generation_](boost::system::error_code ec) {
+        if (generation != self->generation_) {
+          return;
+        }
+        self->write_waiting_ = false;
+        if (ec || self->ctx_ == nullptr || !self->want_write_) {
+          return;
+        }
+        // 输出缓冲写完时hiredis会调用DelWrite
+        redisAsyncHandleWrite(self->ctx_);
+        if (self->ctx_ != nullptr && self->want_write_ &&
+            !self->write_waiting_) {
+          self->WaitWrite();
+        }
+      });
+}
+
+void RedisAsyncConnection::AddRead(void* data) {
+  auto* self = static_cast<RedisAsyncConnection*>(data);
+  self->want_read_ = true;
+  if (!self->read_waiting_) {
+    self->WaitRead();
+  }
+}
+
+void RedisAsyncConnection::DelRead(void* data) {
+  static_cast<RedisAsyncConnection*>(data)->want_read_ = false;
+}
+
+void RedisAsyncConnection::AddWrite(void* data) {
+  auto* self = static_cast<RedisAsyncConnection*>(data);
+  self->want_write_ = true;
+  if (!self->write_waiting_) {
+    self->WaitWrite();
+  }
+}
+
+void RedisAsyncConnection::DelWrite(void* data) {
+  static_cast<RedisAsyncConnection*>(data)->want_write_ = false;
+}
+
+void RedisAsyncConnection::Cleanup(void* data) {
+  auto* self = static_cast<RedisAsyncConnection*>(data);
+  self->want_read_ = false;
+  self->want_write_ = false;
+  if (self->socket_) {
+    boost::system::error_code ec;
+    self->socket_->cancel(ec);
+    self->socket_->release();
+    self->socket_.reset();
+  }
+  self->ctx_ = nullptr;
+  self->connected_ = false;
+}
+
+void RedisAsyncConnection::OnConnect(const redisAsyncContext* ac, int status) {
+  auto* self = static_cast<RedisAsyncConnection*>(ac->data);
+  if (status != REDIS_OK) {
+    // 回调返回后hiredis释放连接
+    std::cout << "redis async connect failed, error is " << ac->errstr
+              << std::endl;
+    self->ScheduleReconnect();
+    return;
+  }
+  self->connected_ = true;
+  std::cout << "redis async connection connected" << std::endl;
+}
+
+void RedisAsyncConnection::OnDisconnect(const redisAsyncContext* ac,
+                                        int status) {
+  auto* self = static_cast<RedisAsyncConnection*>(ac->data);
+  self->connected_ = false;
+  if (status != REDIS_OK) {
+    std::cout << "redis async connection lost, error is " << ac->errstr
+              << std::endl;
+  }
+  self->ScheduleReconnect();
+}
+
+void RedisAsyncConnection::OnReply(redisAsyncContext*, void* reply,
+                                   void* privdata) {
+  std::unique_ptr<RedisPending> op(static_cast<RedisPending*>(privdata));
+  // 连接断开或释放时未完成的命令收到空回复
+  if (reply == nullptr) {
+    Finish(std::move(op), net::error::connection_reset, RedisReply());
+    return;
+  }
+  Finish(std::move(op), boost::system::error_code(),
+         ToReply(static_cast<redisReply*>(reply)));
+}
+
+void RedisAsyncConnection::OnMessage(redisAsyncContext*, void* reply,
+                                     void* privdata) {
+  auto* subscription = static_cast<RedisSubscription*>(privdata);
+  // 连接断开或者释放时订阅回调收到空回复
+  if (reply == nullptr) {
+    if (subscription->on_state_) {
+      subscription->on_state_(false);
+    }
+    return;
+  }
+  // 订阅确认和消息都是三个元素的数组, RESP3下为push类型
+  auto* r = static_cast<redisReply*>(reply);
+  if ((r->type != REDIS_REPLY_ARRAY && r->type != REDIS_REPLY_PUSH) ||
+      r->elements < 3 || r->element[0]->str == nullptr) {
+    return;
+  }
+  std::string kind(r->element[0]->str, r->element[0]->len);
+  if (kind == "subscribe") {
+    if (subscription->on_state_) {
+      subscription->on_state_(true);
+    }
+  } else if (kind == "message" && r->element[2]->str != nullptr) {
+    subscription->on_message_(
+        std::string(r->element[2]->str, r->element[2]->len));
+  }
+}
+
+RedisAsyncClient::RedisAsyncClient()
+    : work_(net::make_work_guard(ioc_)), next_(0), stopped_(false) {
+  auto& cfg = ConfigManager::GetInstance();
+  std::string host = cfg["Redis"]["Host"];
+  int port = atoi(cfg["Redis"]["Port"].c_str());
+  auto count = cfg["Redis"]["AsyncConnections"];
+  std::size_t size = count.empty()
+                         ? kDefaultConnections
+                         : std::max<std::size_t>(std::stoul(count), 1);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto conn = std::make_shared<RedisAsyncConnection>(ioc_, host, port);
+    net::post(ioc_, [conn]() { conn->Connect(); });
+    conns_.push_back(std::move(conn));
+  }
+  sub_conn_ = std::make_shared<RedisAsyncConnection>(ioc_, host, port);
+  thread_ = std::thread([this]() { ioc_.run(); });
+  std::cout << "redis async connection count is " << size << std::endl;
+}
+
+RedisAsyncClient::~RedisAsyncClient() { Stop(); }
+
+void RedisAsyncClient::Stop() {
+  if (stopped_.exchange(true)) {
+    return;
+  }
+  for (auto& conn : conns_) {
+    net::post(ioc_, [conn]() { conn->Close(); });
+  }
+  net::post(ioc_, [conn = sub_conn_]() { conn->Close(); });
+  work_.reset();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void RedisAsyncClient::Subscribe(RedisSubscription subscription) {
+  net::post(ioc_, [conn = sub_conn_,
+                   subscription = std::move(subscription)]() mutable {
+    conn->AddSubscription(std::move(subscription));
+  });
+}
+
+void RedisAsyncClient::Submit(std::vector<std::string> args,
+                              std::unique_ptr<RedisPending> op) {
+  static auto& commands =
+      Metrics::GetInstance()->Counter("redis.async.commands");
+  static auto& inflight =
+      Metrics::GetInstance()->Counter("redis.async.inflight");
+  commands++;
+  inflight++;
+  if (stopped_) {
+    Finish(std::move(op), net::error::shut_down, RedisReply());
+    return;
+  }
+  // 轮流选择连接, 跳过正在重连的
+  std::size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+  std::size_t index = start % conns_.size();
+  for (std::size_t i = 0; i < conns_.size(); ++i) {
+    std::size_t candidate = (start + i) % conns_.size();
+    if (conns_[candidate]->Connected()) {
+      index = candidate;
+      break;
+    }
+  }
+  conns_[index]->Push(RedisCommand{std::move(args), std::move(op)});
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "Singleton.hpp"
+#include "utilities.hpp"
+
+class RedisAsyncConnection;
+
+// redis回复的拷贝, hiredis在回调返回后就释放原始回复
+struct RedisReply {
+  int type_ = REDIS_REPLY_NIL;
+  long long integer_ = 0;
+  std::string str_;
+  std::vector<RedisReply> elements_;
+
+  bool IsNil() const { return type_ == REDIS_REPLY_NIL; }
+  bool IsString() const { return type_ == REDIS_REPLY_STRING; }
+  bool IsError() const { return type_ == REDIS_REPLY_ERROR; }
+};
+
+// 频道订阅, 回调都在redis线程执行, 不能阻塞
+struct RedisSubscription {
+  std::string channel_;
+  std::function<void(const std::string& message)> on_message_;
+  // 订阅生效时以true调用, 包括断线重连后重新订阅; 连接断开时以false调用,
+  // 断开期间发布的消息不会补发
+  std::function<void(bool subscribed)> on_state_;
+};
+
+// 等待回复的命令, 收到回复或者失败时调用且只调用一次Complete
+class RedisPending {
+ public:
+  virtual ~RedisPending() {}
+  virtual void Complete(boost::system::error_code ec, RedisReply reply) = 0;
+};
+
+// 完成时把回调投递到它关联的executor上执行, 协程等待时即回到原来的线程.
+// 等待期间持有该executor的outstanding work, 保证io_context不会提前退出
+template <typename Handler>
+class RedisPendingOp : public RedisPending {
+  using Executor = net::associated_executor_t<Handler, net::any_io_executor>;
+  using WorkExecutor = std::decay_t<decltype(net::prefer(
+      std::declval<Executor>(), net::execution::outstanding_work.tracked))>;
+
+ public:
+  RedisPendingOp(Handler handler, const net::any_io_executor& fallback)
+      : handler_(std::move(handler)),
+        work_(net::prefer(net::get_associated_executor(handler_, fallback),
+                          net::execution::outstanding_work.tracked)) {}
+
+  void Complete(boost::system::error_code ec, RedisReply reply) override {
+    auto work = std::move(work_);
+    net::post(work, [handler = std::move(handler_), ec,
+                     reply = std::move(reply)]() mutable {
+      handler(ec, std::move(reply));
+    });
+  }
+
+ private:
+  Handler handler_;
+  WorkExecutor work_;
+};
+
+// 基于hiredis异步接口的redis客户端, 连接的读写由自己的io线程驱动.
+// 各线程提交的命令轮流分配到少量连接上, 同一连接上一次唤醒期间积累的
+// 命令一起写出, 不等前一条的回复, 即自动流水线.
+// 完成回调的签名为 void(boost::system::error_code, RedisReply),
+// redis返回的错误不算失败, 由调用方检查IsError; 连接断开时返回错误码.
+// 协程中用use_awaitable等待, 同步代码可以用use_future取得future.
+// 没有关联executor的回调在redis线程上执行, 不能阻塞
+class RedisAsyncClient : public Singleton<RedisAsyncClient> {
+  friend class Singleton<RedisAsyncClient>;
+
+ public:
+  ~RedisAsyncClient();
+
+  template <typename CompletionToken>
+  auto AsyncCommand(std::vector<std::string> args, CompletionToken&& token) {
+    return net::async_initiate<CompletionToken,
+                               void(boost::system::error_code, RedisReply)>(
+        [this](auto handler, std::vector<std::string> args) {
+          using Handler = std::decay_t<decltype(handler)>;
+          Submit(std::move(args), std::make_unique<RedisPendingOp<Handler>>(
+                                      std::move(handler), ioc_.get_executor()));
+        },
+        token, std::move(args));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncGet(const std::string& key, CompletionToken&& token) {
+    return AsyncCommand({"GET", key}, std::forward<CompletionToken>(token));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncSet(const std::string& key, const std::string& value,
+                CompletionToken&& token) {
+    return AsyncCommand({"SET", key, value},
+                        std::forward<CompletionToken>(token));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncHGet(const std::string& key, const std::string& hkey,
+                 CompletionToken&& token) {
+    return AsyncCommand({"HGET", key, hkey},
+                        std::forward<CompletionToken>(token));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncHIncrBy(const std::string& key, const std::string& hkey,
+                    long long increment, CompletionToken&& token) {
+    return AsyncCommand({"HINCRBY", key, hkey, std::to_string(increment)},
+                        std::forward<CompletionToken>(token));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncDel(const std::string& key, CompletionToken&& token) {
+    return AsyncCommand({"DEL", key}, std::forward<CompletionToken>(token));
+  }
+
+  template <typename CompletionToken>
+  auto AsyncPublish(const std::string& channel, const std::string& message,
+                    CompletionToken&& token) {
+    return AsyncCommand({"PUBLISH", channel, message},
+                        std::forward<CompletionToken>(token));
+  }
+
+  // 任意线程调用. 订阅使用单独的连接, 断线后自动重连并重新订阅
+  void Subscribe(RedisSubscription subscription);
+
+  // 断开所有连接, 未完成的命令以错误结束
+  void Stop();
+
+ private:
+  RedisAsyncClient();
+  // 任意线程调用
+  void Submit(std::vector<std::string> args, std::unique_ptr<RedisPending> op);
+
+  net::io_context ioc_;
+  net::executor_work_guard<net::io_context::executor_type> work_;
+  std::vector<std::shared_ptr<RedisAsyncConnection>> conns_;
+  // 处于订阅模式的连接不能再执行普通命令
+  std::shared_ptr<RedisAsyncConnection> sub_conn_;
+  std::atomic<std::size_t> next_;
+  std::atomic<bool> stopped_;
+  std::thread thread_;
+};
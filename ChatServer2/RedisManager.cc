@@ -1,31 +1,79 @@
 #include "RedisManager.hpp"
 
 #include "ConfigManager.hpp"
+#include "Metrics.hpp"
+
+namespace {
+const std::size_t kDefaultPoolSize = 5;
+const int kDefaultAcquireMs = 3000;
+const int kConnectTimeoutSec = 3;
+// 单条MGET的key数, 避免一条命令过大长时间占住redis
+const std::size_t kMaxKeysPerCommand = 256;
+
+// 借用连接的等待时间分布, 按微秒分桶
+void RecordWait(std::chrono::steady_clock::duration wait) {
+  static std::atomic<int64_t> *buckets[] = {
+      &Metrics::GetInstance()->Counter("redis.pool.wait_lt_100us"),
+      &Metrics::GetInstance()->Counter("redis.pool.wait_lt_1ms"),
+      &Metrics::GetInstance()->Counter("redis.pool.wait_lt_10ms"),
+      &Metrics::GetInstance()->Counter("redis.pool.wait_lt_100ms"),
+      &Metrics::GetInstance()->Counter("redis.pool.wait_ge_100ms"),
+  };
+  auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+  std::size_t index = 0;
+  for (int64_t bound = 100; index < 4 && us >= bound; bound *= 10) {
+    ++index;
+  }
+  (*buckets[index])++;
+}
+}  // namespace
+
+RedisLease::RedisLease(RedisLease &&other) noexcept
+    : pool_(other.pool_), context_(other.context_) {
+  other.pool_ = nullptr;
+  other.context_ = nullptr;
+}
+
+RedisLease &RedisLease::operator=(RedisLease &&other) noexcept {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    context_ = other.context_;
+    other.pool_ = nullptr;
+    other.context_ = nullptr;
+  }
+  return *this;
+}
 
-RedisConnectPool::RedisConnectPool(std::size_t size, const char *host,
-                                   const char *port, const char *pwd)
-    : size_(size), host_(host), port_(port), stop_(false) {
+void RedisLease::Release() {
+  if (context_ != nullptr) {
+    pool_->ReturnConnection(context_);
+    context_ = nullptr;
+  }
+}
+
+RedisConnectPool::RedisConnectPool(std::size_t size, const std::string &host,
+                                   const std::string &port,
+                                   const std::string &pwd,
+                                   int acquire_timeout_ms)
+    : stop_(false),
+      host_(host),
+      port_(port),
+      pwd_(pwd),
+      size_(size),
+      live_(0),
+      acquire_timeout_(acquire_timeout_ms) {
   for (std::size_t i = 0; i < size; ++i) {
-    redisContext *context = redisConnect(host, atoi(port));
-    if (context == nullptr || context->err != 0) {
-      if (context != nullptr) {
-        redisFree(context);
-      }
+    auto *context = Connect();
+    if (context == nullptr) {
       continue;
     }
-    if (pwd != "") {
-      auto reply = (redisReply *)redisCommand(context, "AUTH %s", pwd);
-      if (reply->type == REDIS_REPLY_ERROR) {
-        std::cout << "Authenticate failed!" << std::endl;
-        freeReplyObject(reply);
-        continue;
-      }
-      freeReplyObject(reply);
-      std::cout << "Authenticate succeed!" << std::endl;
-    }
     connections_.push(context);
+    ++live_;
   }
-  std::cout << "Redis connection connected" << std::endl;
+  std::cout << "Redis connection connected " << live_ << "/" << size_
+            << std::endl;
 }
 
 RedisConnectPool::~RedisConnectPool() {
@@ -38,30 +86,100 @@ RedisConnectPool::~RedisConnectPool() {
   }
 }
 
-redisContext *RedisConnectPool::GetConnection() {
-  std::unique_lock<std::mutex> lock(mtx_);
-  cond_.wait(lock, [this]() {
-    if (stop_) {
-      return true;
+redisContext *RedisConnectPool::Connect() {
+  struct timeval timeout = {kConnectTimeoutSec, 0};
+  redisContext *context =
+      redisConnectWithTimeout(host_.c_str(), atoi(port_.c_str()), timeout);
+  if (context == nullptr || context->err != 0) {
+    std::cout << "Redis connect failed, error is "
+              << (context == nullptr ? "alloc failed" : context->errstr)
+              << std::endl;
+    if (context != nullptr) {
+      redisFree(context);
     }
-    return !connections_.empty();
-  });
-
-  if (stop_) {
     return nullptr;
   }
-
-  redisContext *context = connections_.front();
-  connections_.pop();
+  if (!pwd_.empty()) {
+    auto reply = (redisReply *)redisCommand(context, "AUTH %s", pwd_.c_str());
+    if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
+      std::cout << "Authenticate failed!" << std::endl;
+      freeReplyObject(reply);
+      redisFree(context);
+      return nullptr;
+    }
+    freeReplyObject(reply);
+  }
   return context;
 }
 
+RedisLease RedisConnectPool::Acquire() {
+  static auto &in_use = Metrics::GetInstance()->Counter("redis.pool.in_use");
+  static auto &timeouts =
+      Metrics::GetInstance()->Counter("redis.pool.acquire_timeouts");
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + acquire_timeout_;
+  redisContext *context = nullptr;
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (context == nullptr) {
+    if (stop_) {
+      return RedisLease();
+    }
+    if (!connections_.empty()) {
+      context = connections_.front();
+      connections_.pop();
+      break;
+    }
+    if (live_ < size_) {
+      // 断开的连接没有补上, 先占住名额, 建连时不持锁
+      ++live_;
+      lock.unlock();
+      context = Connect();
+      lock.lock();
+      if (context != nullptr) {
+        break;
+      }
+      --live_;
+      if (live_ == 0) {
+        // 一条连接都没有, redis不可用, 不必等待
+        return RedisLease();
+      }
+    }
+    if (cond_.wait_until(lock, deadline) == std::cv_status::timeout &&
+        connections_.empty()) {
+      timeouts++;
+      std::cout << "Redis acquire connection timeout" << std::endl;
+      return RedisLease();
+    }
+  }
+  lock.unlock();
+  in_use++;
+  RecordWait(std::chrono::steady_clock::now() - start);
+  return RedisLease(this, context);
+}
+
 void RedisConnectPool::ReturnConnection(redisContext *context) {
+  static auto &in_use = Metrics::GetInstance()->Counter("redis.pool.in_use");
+  static auto &reconnects =
+      Metrics::GetInstance()->Counter("redis.pool.reconnects");
+  in_use--;
+  // hiredis的连接出错后不能再使用, 关闭后重建一条补上
+  if (context->err != 0) {
+    std::cout << "Redis connection broken, error is " << context->errstr
+              << std::endl;
+    redisFree(context);
+    context = stop_ ? nullptr : Connect();
+    reconnects++;
+  }
   std::lock_guard<std::mutex> lock(mtx_);
-  if (stop_) {
+  if (context == nullptr || stop_) {
+    if (context != nullptr) {
+      redisFree(context);
+    }
+    --live_;
+    // 让等待者有机会自己补建连接
+    cond_.notify_one();
     return;
   }
-
   connections_.push(context);
   cond_.notify_one();
 }
@@ -75,7 +193,11 @@ RedisManager::RedisManager() {
   auto &config_mannager = ConfigManager::GetInstance();
   std::string host = config_mannager["Redis"]["Host"];
   std::string port = config_mannager["Redis"]["Port"];
-  pool_.reset(new RedisConnectPool(5, host.c_str(), port.c_str()));
+  auto pool_size = config_mannager["Redis"]["PoolSize"];
+  auto acquire_ms = config_mannager["Redis"]["AcquireTimeoutMs"];
+  pool_.reset(new RedisConnectPool(
+      pool_size.empty() ? kDefaultPoolSize : std::stoul(pool_size), host, port,
+      "", acquire_ms.empty() ? kDefaultAcquireMs : std::stoi(acquire_ms)));
 }
 
 RedisManager::~RedisManager() { Close(); }
@@ -83,11 +205,11 @@ RedisManager::~RedisManager() { Close(); }
 void RedisManager::Close() { pool_->Close(); }
 
 bool RedisManager::Get(const std::string &key, std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "GET %s", key.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "GET %s", key.c_str());
   if (nullptr == reply) {
     std::cout << "[ GET  " << key << " ] failed" << std::endl;
     freeReplyObject(reply);
@@ -100,21 +222,130 @@ bool RedisManager::Get(const std::string &key, std::string &value) {
     return false;
   }
 
-  value = reply->str;
+  value.assign(reply->str, reply->len);
   freeReplyObject(reply);
 
   std::cout << "Succeed to execute command [ GET " << key << "  ]" << std::endl;
   return true;
 }
 
+bool RedisManager::SetEx(const std::string &key, const std::string &value,
+                         int ttl_sec) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
+    return false;
+  }
+  std::string ttl = std::to_string(ttl_sec);
+  const char *argv[] = {"SET", key.data(), value.data(), "EX", ttl.data()};
+  size_t argvlen[] = {3, key.size(), value.size(), 2, ttl.size()};
+  auto reply = (redisReply *)redisCommandArgv(connect.Get(), 5, argv, argvlen);
+  if (reply == nullptr || reply->type != REDIS_REPLY_STATUS) {
+    std::cout << "Execut command [ SET " << key << " EX " << ttl
+              << " ] failure ! " << std::endl;
+    freeReplyObject(reply);
+    return false;
+  }
+  freeReplyObject(reply);
+  return true;
+}
+
+bool RedisManager::MGet(const std::vector<std::string> &keys,
+                        std::vector<std::optional<std::string>> &values) {
+  values.assign(keys.size(), std::nullopt);
+  if (keys.empty()) {
+    return true;
+  }
+  auto connect = pool_->Acquire();
+  if (!connect) {
+    return false;
+  }
+  // 先把所有MGET写进输出缓冲, 第一次读回复时一起发出
+  std::size_t commands = 0;
+  std::vector<const char *> argv;
+  std::vector<size_t> argvlen;
+  for (std::size_t begin = 0; begin < keys.size();
+       begin += kMaxKeysPerCommand) {
+    std::size_t end = std::min(keys.size(), begin + kMaxKeysPerCommand);
+    argv.assign(1, "MGET");
+    argvlen.assign(1, 4);
+    for (std::size_t i = begin; i < end; ++i) {
+      argv.push_back(keys[i].data());
+      argvlen.push_back(keys[i].size());
+    }
+    redisAppendCommandArgv(connect.Get(), static_cast<int>(argv.size()),
+                           argv.data(), argvlen.data());
+    ++commands;
+  }
+  bool success = true;
+  for (std::size_t n = 0; n < commands; ++n) {
+    redisReply *reply = nullptr;
+    if (redisGetReply(connect.Get(), (void **)&reply) != REDIS_OK) {
+      // 连接已出错, 剩下的回复不会再来, 归还时由连接池重建
+      std::cout << "Execut command [ MGET " << keys.size()
+                << " keys ] failure ! " << std::endl;
+      return false;
+    }
+    // 出错的那条也要读走回复, 连接才能继续使用
+    if (reply->type != REDIS_REPLY_ARRAY) {
+      success = false;
+      freeReplyObject(reply);
+      continue;
+    }
+    std::size_t begin = n * kMaxKeysPerCommand;
+    for (std::size_t i = 0; i < reply->elements && begin + i < keys.size();
+         ++i) {
+      auto *element = reply->element[i];
+      if (element->type == REDIS_REPLY_STRING) {
+        values[begin + i].emplace(element->str, element->len);
+      }
+    }
+    freeReplyObject(reply);
+  }
+  return success;
+}
+
+bool RedisManager::MSetEx(
+    const std::vector<std::pair<std::string, std::string>> &kvs,
+    int ttl_sec) {
+  if (kvs.empty()) {
+    return true;
+  }
+  auto connect = pool_->Acquire();
+  if (!connect) {
+    return false;
+  }
+  // MSET不能带过期时间, 每个key一条SET, 一起流水线发送
+  std::string ttl = std::to_string(ttl_sec);
+  for (auto &kv : kvs) {
+    const char *argv[] = {"SET", kv.first.data(), kv.second.data(), "EX",
+                          ttl.data()};
+    size_t argvlen[] = {3, kv.first.size(), kv.second.size(), 2, ttl.size()};
+    redisAppendCommandArgv(connect.Get(), 5, argv, argvlen);
+  }
+  bool success = true;
+  for (std::size_t n = 0; n < kvs.size(); ++n) {
+    redisReply *reply = nullptr;
+    if (redisGetReply(connect.Get(), (void **)&reply) != REDIS_OK) {
+      std::cout << "Execut command [ SET EX " << kvs.size()
+                << " keys ] failure ! " << std::endl;
+      return false;
+    }
+    if (reply->type != REDIS_REPLY_STATUS) {
+      success = false;
+    }
+    freeReplyObject(reply);
+  }
+  return success;
+}
+
 bool RedisManager::Set(const std::string &key, const std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
   // 执行redis命令行
-  auto reply = (redisReply *)redisCommand(connect, "SET %s %s", key.c_str(),
-                                          value.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "SET %s %s",
+                                          key.c_str(), value.c_str());
   // 如果返回nullptr则说明执行失败
   if (nullptr == reply) {
     std::cout << "Execut command [ SET " << key << "  " << value
@@ -138,12 +369,13 @@ bool RedisManager::Set(const std::string &key, const std::string &value) {
 }
 
 bool RedisManager::Auth(const std::string &password) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "AUTH %s", password.c_str());
-  if (reply->type == REDIS_REPLY_ERROR) {
+  auto reply =
+      (redisReply *)redisCommand(connect.Get(), "AUTH %s", password.c_str());
+  if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
     std::cout << "认证失败" << std::endl;
     // 执行成功 释放redisCommand执行后返回的redisReply所占用的内存
     freeReplyObject(reply);
@@ -157,12 +389,12 @@ bool RedisManager::Auth(const std::string &password) {
 }
 
 bool RedisManager::LPush(const std::string &key, const std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "LPUSH %s %s", key.c_str(),
-                                          value.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "LPUSH %s %s",
+                                          key.c_str(), value.c_str());
   if (nullptr == reply) {
     std::cout << "Execut command [ LPUSH " << key << "  " << value
               << " ] failure ! " << std::endl;
@@ -184,12 +416,13 @@ bool RedisManager::LPush(const std::string &key, const std::string &value) {
 }
 
 bool RedisManager::LPop(const std::string &key, std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "LPOP %s ", key.c_str());
-  if (reply == nullptr || reply->type == REDIS_REPLY_NIL) {
+  auto reply =
+      (redisReply *)redisCommand(connect.Get(), "LPOP %s ", key.c_str());
+  if (reply == nullptr || reply->type != REDIS_REPLY_STRING) {
     std::cout << "Execut command [ LPOP " << key << " ] failure ! "
               << std::endl;
     freeReplyObject(reply);
@@ -202,12 +435,12 @@ bool RedisManager::LPop(const std::string &key, std::string &value) {
 }
 
 bool RedisManager::RPush(const std::string &key, const std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "RPUSH %s %s", key.c_str(),
-                                          value.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "RPUSH %s %s",
+                                          key.c_str(), value.c_str());
   if (nullptr == reply) {
     std::cout << "Execut command [ RPUSH " << key << "  " << value
               << " ] failure ! " << std::endl;
@@ -229,12 +462,13 @@ bool RedisManager::RPush(const std::string &key, const std::string &value) {
 }
 
 bool RedisManager::RPop(const std::string &key, std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "RPOP %s ", key.c_str());
-  if (reply == nullptr || reply->type == REDIS_REPLY_NIL) {
+  auto reply =
+      (redisReply *)redisCommand(connect.Get(), "RPOP %s ", key.c_str());
+  if (reply == nullptr || reply->type != REDIS_REPLY_STRING) {
     std::cout << "Execut command [ RPOP " << key << " ] failure ! "
               << std::endl;
     freeReplyObject(reply);
@@ -248,12 +482,13 @@ bool RedisManager::RPop(const std::string &key, std::string &value) {
 
 bool RedisManager::HSet(const std::string &key, const std::string &hkey,
                         const std::string &value) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "HSET %s %s %s", key.c_str(),
-                                          hkey.c_str(), value.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "HSET %s %s %s",
+                                          key.c_str(), hkey.c_str(),
+                                          value.c_str());
   if (reply == nullptr || reply->type != REDIS_REPLY_INTEGER) {
     std::cout << "Execut command [ HSet " << key << "  " << hkey << "  "
               << value << " ] failure ! " << std::endl;
@@ -268,8 +503,8 @@ bool RedisManager::HSet(const std::string &key, const std::string &hkey,
 
 bool RedisManager::HSet(const char *key, const char *hkey, const char *hvalue,
                         size_t hvaluelen) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
   const char *argv[4];
@@ -282,7 +517,7 @@ bool RedisManager::HSet(const char *key, const char *hkey, const char *hvalue,
   argvlen[2] = strlen(hkey);
   argv[3] = hvalue;
   argvlen[3] = hvaluelen;
-  auto reply = (redisReply *)redisCommandArgv(connect, 4, argv, argvlen);
+  auto reply = (redisReply *)redisCommandArgv(connect.Get(), 4, argv, argvlen);
   if (reply == nullptr || reply->type != REDIS_REPLY_INTEGER) {
     std::cout << "Execut command [ HSet " << key << "  " << hkey << "  "
               << hvalue << " ] failure ! " << std::endl;
@@ -297,8 +532,8 @@ bool RedisManager::HSet(const char *key, const char *hkey, const char *hvalue,
 
 std::string RedisManager::HGet(const std::string &key,
                                const std::string &hkey) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return "";
   }
   const char *argv[3];
@@ -309,8 +544,8 @@ std::string RedisManager::HGet(const std::string &key,
   argvlen[1] = key.length();
   argv[2] = hkey.c_str();
   argvlen[2] = hkey.length();
-  auto reply = (redisReply *)redisCommandArgv(connect, 3, argv, argvlen);
-  if (reply == nullptr || reply->type == REDIS_REPLY_NIL) {
+  auto reply = (redisReply *)redisCommandArgv(connect.Get(), 3, argv, argvlen);
+  if (reply == nullptr || reply->type != REDIS_REPLY_STRING) {
     freeReplyObject(reply);
     std::cout << "Execut command [ HGet " << key << " " << hkey
               << "  ] failure ! " << std::endl;
@@ -324,12 +559,31 @@ std::string RedisManager::HGet(const std::string &key,
   return value;
 }
 
+bool RedisManager::HIncrBy(const std::string &key, const std::string &hkey,
+                           long long increment) {
+  auto conn = pool_->Acquire();
+  if (!conn) {
+    return false;
+  }
+
+  auto reply = (redisReply *)redisCommand(conn.Get(), "HINCRBY %s %s %lld",
+                                          key.c_str(), hkey.c_str(), increment);
+  if (reply == nullptr || reply->type != REDIS_REPLY_INTEGER) {
+    std::cout << "Execut command [ HIncrBy " << key << "  " << hkey << "  "
+              << increment << " ] failure ! " << std::endl;
+    freeReplyObject(reply);
+    return false;
+  }
+  freeReplyObject(reply);
+  return true;
+}
+
 bool RedisManager::Del(const std::string &key) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "DEL %s", key.c_str());
+  auto reply = (redisReply *)redisCommand(connect.Get(), "DEL %s", key.c_str());
   if (reply == nullptr || reply->type != REDIS_REPLY_INTEGER) {
     std::cout << "Execut command [ Del " << key << " ] failure ! " << std::endl;
     freeReplyObject(reply);
@@ -341,11 +595,12 @@ bool RedisManager::Del(const std::string &key) {
 }
 
 bool RedisManager::ExistsKey(const std::string &key) {
-  auto *connect = pool_->GetConnection();
-  if (nullptr == connect) {
+  auto connect = pool_->Acquire();
+  if (!connect) {
     return false;
   }
-  auto reply = (redisReply *)redisCommand(connect, "exists %s", key.c_str());
+  auto reply =
+      (redisReply *)redisCommand(connect.Get(), "exists %s", key.c_str());
   if (reply == nullptr || reply->type != REDIS_REPLY_INTEGER ||
       reply->integer == 0) {
     std::cout << "Not Found [ Key " << key << " ]  ! " << std::endl;
@@ -358,13 +613,12 @@ bool RedisManager::ExistsKey(const std::string &key) {
 }
 
 bool RedisManager::HDel(const std::string &key, const std::string &filed) {
-  auto conn = pool_->GetConnection();
-  if (conn == nullptr) {
+  auto conn = pool_->Acquire();
+  if (!conn) {
     return false;
   }
-  Defer defer([this, &conn]() { pool_->ReturnConnection(std::move(conn)); });
 
-  auto reply = (redisReply *)redisCommand(conn, "HDEL %s %s", key.c_str(),
+  auto reply = (redisReply *)redisCommand(conn.Get(), "HDEL %s %s", key.c_str(),
                                           filed.c_str());
   if (reply == nullptr) {
     std::cout << "HDEL command failed!" << std::endl;
@@ -2,21 +2,56 @@
 #include "Singleton.hpp"
 #include "utilities.hpp"
 
+class RedisConnectPool;
+
+// 从连接池借出的连接, 析构时自动归还. 归还时连接已出错(err非0)的,
+// 由连接池关闭并重建, 不会把坏连接放回池中
+class RedisLease {
+ public:
+  RedisLease() : pool_(nullptr), context_(nullptr) {}
+  RedisLease(RedisConnectPool *pool, redisContext *context)
+      : pool_(pool), context_(context) {}
+  ~RedisLease() { Release(); }
+  RedisLease(RedisLease &&other) noexcept;
+  RedisLease &operator=(RedisLease &&other) noexcept;
+  RedisLease(const RedisLease &) = delete;
+  RedisLease &operator=(const RedisLease &) = delete;
+
+  redisContext *Get() const { return context_; }
+  explicit operator bool() const { return context_ != nullptr; }
+  // 提前归还连接
+  void Release();
+
+ private:
+  RedisConnectPool *pool_;
+  redisContext *context_;
+};
+
 class RedisConnectPool {
  public:
-  RedisConnectPool(std::size_t size, const char *host, const char *port,
-                   const char *pwd = "");
+  RedisConnectPool(std::size_t size, const std::string &host,
+                   const std::string &port, const std::string &pwd,
+                   int acquire_timeout_ms);
   ~RedisConnectPool();
 
-  redisContext *GetConnection();
-  void ReturnConnection(redisContext *context);
+  // 等待超过acquire_timeout_ms, redis不可用或者连接池已关闭时返回空的lease
+  RedisLease Acquire();
   void Close();
 
  private:
+  friend class RedisLease;
+  void ReturnConnection(redisContext *context);
+  // 建立一条连接并认证, 失败返回nullptr, 调用时不持锁
+  redisContext *Connect();
+
   std::atomic<bool> stop_;
-  const char *host_;
-  const char *port_;
+  std::string host_;
+  std::string port_;
+  std::string pwd_;
   std::size_t size_;
+  // 已建立的连接数, 包括借出的; 小于size_时由Acquire补建
+  std::size_t live_;
+  std::chrono::milliseconds acquire_timeout_;
   std::queue<redisContext *> connections_;
   std::condition_variable cond_;
   std::mutex mtx_;
@@ -30,6 +65,15 @@ class RedisManager : public Singleton<RedisManager>,
   ~RedisManager();
   bool Get(const std::string &key, std::string &value);
   bool Set(const std::string &key, const std::string &value);
+  // 二进制安全, 值在ttl_sec秒后过期
+  bool SetEx(const std::string &key, const std::string &value, int ttl_sec);
+  // 一次往返取回多个key, values与keys一一对应, 不存在的为nullopt.
+  // key较多时拆成几条MGET一起流水线发送
+  bool MGet(const std::vector<std::string> &keys,
+            std::vector<std::optional<std::string>> &values);
+  // 流水线写入多个带过期时间的值, 一次往返
+  bool MSetEx(const std::vector<std::pair<std::string, std::string>> &kvs,
+              int ttl_sec);
   // 密码认证
   bool Auth(const std::string &password);
   bool LPush(const std::string &key, const std::string &value);
@@ -41,6 +85,9 @@ class RedisManager : public Singleton<RedisManager>,
   bool HSet(const char *key, const char *hkey, const char *hvalue,
             size_t hvaluelen);
   std::string HGet(const std::string &key, const std::string &hkey);
+  // 原子地增加哈希字段的整数值
+  bool HIncrBy(const std::string &key, const std::string &hkey,
+               long long increment);
   bool Del(const std::string &key);
   bool HDel(const std::string &key, const std::string &filed);
   bool ExistsKey(const std::string &key);
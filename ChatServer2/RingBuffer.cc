@@ -0,0 +1,62 @@
+#include "RingBuffer.hpp"
+
+namespace {
+std::size_t RoundUpPowerOfTwo(std::size_t n) {
+  std::size_t size = 1;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+}  // namespace
+
+RingBuffer::RingBuffer(std::size_t capacity)
+    : capacity_(RoundUpPowerOfTwo(capacity)),
+      mask_(capacity_ - 1),
+      read_pos_(0),
+      write_pos_(0) {
+  data_ = new char[capacity_];
+}
+
+RingBuffer::~RingBuffer() { delete[] data_; }
+
+std::size_t RingBuffer::Size() const { return write_pos_ - read_pos_; }
+
+std::size_t RingBuffer::Available() const { return capacity_ - Size(); }
+
+std::size_t RingBuffer::Capacity() const { return capacity_; }
+
+std::array<net::mutable_buffer, 2> RingBuffer::PrepareBuffers() {
+  std::size_t avail = Available();
+  std::size_t start = write_pos_ & mask_;
+  std::size_t first = std::min(avail, capacity_ - start);
+  return {net::buffer(data_ + start, first),
+          net::buffer(data_, avail - first)};
+}
+
+void RingBuffer::Commit(std::size_t n) {
+  assert(n <= Available());
+  write_pos_ += n;
+}
+
+void RingBuffer::Peek(char* dst, std::size_t n, std::size_t offset) const {
+  assert(offset + n <= Size());
+  std::size_t start = (read_pos_ + offset) & mask_;
+  std::size_t first = std::min(n, capacity_ - start);
+  ::memcpy(dst, data_ + start, first);
+  ::memcpy(dst + first, data_, n - first);
+}
+
+void RingBuffer::Consume(std::size_t n) {
+  assert(n <= Size());
+  read_pos_ += n;
+  // 读空时复位, 让后续读取尽量落在连续内存上
+  if (read_pos_ == write_pos_) {
+    read_pos_ = write_pos_ = 0;
+  }
+}
+
+void RingBuffer::Read(char* dst, std::size_t n) {
+  Peek(dst, n);
+  Consume(n);
+}
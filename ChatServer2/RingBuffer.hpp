@@ -0,0 +1,33 @@
+#pragma once
+#include "utilities.hpp"
+
+// 单生产者单消费者的环形接收缓冲区, 只在session所属的io线程中使用
+// 容量向上取整为2的幂, 读写位置单调递增, 通过掩码定位
+class RingBuffer {
+ public:
+  explicit RingBuffer(std::size_t capacity);
+  ~RingBuffer();
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  // 可读字节数
+  std::size_t Size() const;
+  // 可写字节数
+  std::size_t Available() const;
+  std::size_t Capacity() const;
+  // 返回空闲区间, 环绕时拆为两段, 供async_read_some一次读满
+  std::array<net::mutable_buffer, 2> PrepareBuffers();
+  // 内核写入n字节后推进写位置
+  void Commit(std::size_t n);
+  // 从读位置偏移offset处拷贝n字节, 不移动读位置
+  void Peek(char* dst, std::size_t n, std::size_t offset = 0) const;
+  void Consume(std::size_t n);
+  void Read(char* dst, std::size_t n);
+
+ private:
+  char* data_;
+  std::size_t capacity_;
+  std::size_t mask_;
+  std::size_t read_pos_;
+  std::size_t write_pos_;
+};
@@ -0,0 +1,118 @@
+#include "RouteCache.hpp"
+
+#include <sstream>
+
+#include "ConfigManager.hpp"
+#include "RedisAsyncClient.hpp"
+
+namespace {
+const std::size_t kDefaultCapacity = 200000;
+// 路由只随登录和断开变化, 过期时间只是事件丢失时的兜底
+const int kDefaultTtlSec = 600;
+const char kLoginEvent[] = "login";
+const char kLogoutEvent[] = "logout";
+}  // namespace
+
+RouteCache::RouteCache()
+    : subscribed_(false),
+      refreshes_(Metrics::GetInstance()->Counter("routecache.refreshes")) {
+  auto& cfg = ConfigManager::GetInstance();
+  auto capacity = cfg["RouteCache"]["Capacity"];
+  auto ttl = cfg["RouteCache"]["TtlSec"];
+  std::size_t total =
+      capacity.empty() ? kDefaultCapacity : std::stoul(capacity);
+  int ttl_sec = ttl.empty() ? kDefaultTtlSec : std::stoi(ttl);
+  lru_ = std::make_unique<ShardedLru<std::string>>(
+      "routecache", total, std::chrono::seconds(ttl_sec));
+  self_name_ = cfg["SelfServer"]["Name"];
+  std::cout << "route cache capacity " << total << " ttl " << ttl_sec << "s"
+            << std::endl;
+}
+
+void RouteCache::Subscribe() {
+  if (!lru_->Enabled()) {
+    return;
+  }
+  RedisSubscription subscription;
+  subscription.channel_ = kUserRouteChannel;
+  subscription.on_message_ = [this](const std::string& message) {
+    OnEvent(message);
+  };
+  subscription.on_state_ = [this](bool subscribed) {
+    if (subscribed) {
+      // 断开期间可能错过了登录和断开事件
+      lru_->Clear();
+    }
+    subscribed_ = subscribed;
+    std::cout << "route cache subscribed " << subscribed << std::endl;
+  };
+  RedisAsyncClient::GetInstance()->Subscribe(std::move(subscription));
+}
+
+net::awaitable<bool> RouteCache::Resolve(int uid, std::string& server) {
+  uint64_t epoch = 0;
+  if (subscribed_ && lru_->Get(uid, server, epoch)) {
+    co_return true;
+  }
+  co_return co_await Load(uid, epoch, server);
+}
+
+net::awaitable<bool> RouteCache::Refresh(int uid, const std::string& stale,
+                                         std::string& server) {
+  refreshes_++;
+  // 期间收到的新路由不会被删掉
+  lru_->EraseIf(uid, stale);
+  co_return co_await Load(uid, lru_->Epoch(uid), server);
+}
+
+net::awaitable<bool> RouteCache::Load(int uid, uint64_t epoch,
+                                      std::string& server) {
+  boost::system::error_code ec;
+  auto reply = co_await RedisAsyncClient::GetInstance()->AsyncGet(
+      kUserIpPrefix + std::to_string(uid),
+      net::redirect_error(net::use_awaitable, ec));
+  if (ec || !reply.IsString()) {
+    co_return false;
+  }
+  server = std::move(reply.str_);
+  // 查询期间收到过该uid所在分片的事件时, 读到的可能是旧路由, 不写入
+  if (subscribed_) {
+    lru_->Fill(uid, server, epoch);
+  }
+  co_return true;
+}
+
+void RouteCache::PublishLogin(int uid) {
+  if (subscribed_) {
+    lru_->Set(uid, self_name_);
+  }
+  std::ostringstream message;
+  message << kLoginEvent << ' ' << uid << ' ' << self_name_;
+  RedisAsyncClient::GetInstance()->AsyncPublish(kUserRouteChannel,
+                                                message.str(), net::detached);
+}
+
+void RouteCache::PublishLogout(int uid) {
+  lru_->EraseIf(uid, self_name_);
+  std::ostringstream message;
+  message << kLogoutEvent << ' ' << uid << ' ' << self_name_;
+  RedisAsyncClient::GetInstance()->AsyncPublish(kUserRouteChannel,
+                                                message.str(), net::detached);
+}
+
+void RouteCache::OnEvent(const std::string& message) {
+  std::istringstream input(message);
+  std::string event;
+  int uid = 0;
+  std::string server;
+  if (!(input >> event >> uid >> server)) {
+    std::cout << "invalid route event " << message << std::endl;
+    return;
+  }
+  if (event == kLoginEvent) {
+    lru_->Set(uid, std::move(server));
+  } else if (event == kLogoutEvent) {
+    // 用户可能已经在其它服务器重新登录, 只删除指向断开服务器的路由
+    lru_->EraseIf(uid, server);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "ShardedLru.hpp"
+#include "Singleton.hpp"
+#include "utilities.hpp"
+
+// uid到所在ChatServer名字的进程内缓存, 投递消息时不必每次查询redis的uip_.
+// 首次查找时从redis读取并填入, 之后由各服务器在用户登录和断开时向
+// kUserRouteChannel发布的事件更新; 订阅断开期间直接查redis, 重新订阅后清空.
+// 事件到达前缓存可能短暂过期, 投递失败时用Refresh丢弃旧路由重新查询
+class RouteCache : public Singleton<RouteCache> {
+  friend class Singleton<RouteCache>;
+
+ public:
+  ~RouteCache() {}
+
+  // 订阅路由事件, 启动时调用一次
+  void Subscribe();
+  // 查找uid所在的服务器, 用户从未登录或者查询失败时返回false.
+  // 在调用方的协程中等待, 命中缓存时不挂起
+  net::awaitable<bool> Resolve(int uid, std::string& server);
+  // 投递到stale失败后调用, 丢弃仍指向stale的缓存并重新查询redis
+  net::awaitable<bool> Refresh(int uid, const std::string& stale,
+                               std::string& server);
+  // 本服务器上的用户登录和断开, 更新本地缓存并通知其它服务器
+  void PublishLogin(int uid);
+  void PublishLogout(int uid);
+
+ private:
+  RouteCache();
+  net::awaitable<bool> Load(int uid, uint64_t epoch, std::string& server);
+  void OnEvent(const std::string& message);
+
+  std::unique_ptr<ShardedLru<std::string>> lru_;
+  std::string self_name_;
+  // 订阅生效期间才使用缓存
+  std::atomic<bool> subscribed_;
+  std::atomic<int64_t>& refreshes_;
+};
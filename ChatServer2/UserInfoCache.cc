@@ -0,0 +1,70 @@
+#include "UserInfoCache.hpp"
+
+#include "ConfigManager.hpp"
+#include "RedisAsyncClient.hpp"
+
+namespace {
+const std::size_t kDefaultCapacity = 100000;
+const int kDefaultTtlSec = 300;
+}  // namespace
+
+UserInfoCache::UserInfoCache() : subscribed_(false) {
+  auto& cfg = ConfigManager::GetInstance();
+  auto capacity = cfg["UserCache"]["Capacity"];
+  auto ttl = cfg["UserCache"]["TtlSec"];
+  std::size_t total =
+      capacity.empty() ? kDefaultCapacity : std::stoul(capacity);
+  int ttl_sec = ttl.empty() ? kDefaultTtlSec : std::stoi(ttl);
+  lru_ = std::make_unique<ShardedLru<std::shared_ptr<const UserInfo>>>(
+      "usercache", total, std::chrono::seconds(ttl_sec));
+  std::cout << "user info cache capacity " << total << " ttl " << ttl_sec
+            << "s" << std::endl;
+}
+
+void UserInfoCache::Subscribe() {
+  if (!lru_->Enabled()) {
+    return;
+  }
+  RedisSubscription subscription;
+  subscription.channel_ = kUserInfoChannel;
+  subscription.on_message_ = [this](const std::string& message) {
+    try {
+      Invalidate(std::stoi(message));
+    } catch (std::exception& e) {
+      std::cout << "invalid user info notify " << message << std::endl;
+    }
+  };
+  subscription.on_state_ = [this](bool subscribed) {
+    if (subscribed) {
+      // 断开期间可能错过了失效通知
+      Clear();
+    }
+    subscribed_ = subscribed;
+    std::cout << "user info cache subscribed " << subscribed << std::endl;
+  };
+  RedisAsyncClient::GetInstance()->Subscribe(std::move(subscription));
+}
+
+std::shared_ptr<const UserInfo> UserInfoCache::Get(int uid, uint64_t& epoch) {
+  if (!subscribed_) {
+    epoch = lru_->Epoch(uid);
+    return nullptr;
+  }
+  std::shared_ptr<const UserInfo> info;
+  if (!lru_->Get(uid, info, epoch)) {
+    return nullptr;
+  }
+  return info;
+}
+
+void UserInfoCache::Put(int uid, const UserInfo& info, uint64_t epoch) {
+  if (!subscribed_) {
+    return;
+  }
+  // 加载期间收到过失效通知时, 加载到的可能是旧数据, 由lru_丢弃
+  lru_->Fill(uid, std::make_shared<const UserInfo>(info), epoch);
+}
+
+void UserInfoCache::Invalidate(int uid) { lru_->Erase(uid); }
+
+void UserInfoCache::Clear() { lru_->Clear(); }
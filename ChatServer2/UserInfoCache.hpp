@@ -0,0 +1,32 @@
+#pragma once
+#include "ShardedLru.hpp"
+#include "Singleton.hpp"
+#include "data.hpp"
+#include "utilities.hpp"
+
+// 进程内的用户资料缓存, 按uid分片, 每片一个LRU链表, 条目带过期时间.
+// 资料变化时由修改方向kUserInfoChannel发布uid, 各ChatServer订阅后删除
+// 对应条目; 订阅断开期间不使用缓存, 重新订阅后清空, 避免读到错过失效
+// 通知的旧数据. 容量配置为0时不缓存
+class UserInfoCache : public Singleton<UserInfoCache> {
+  friend class Singleton<UserInfoCache>;
+
+ public:
+  ~UserInfoCache() {}
+
+  // 订阅失效通知, 启动时调用一次
+  void Subscribe();
+  // 未命中或者已过期时返回nullptr, 并通过epoch返回当前的失效版本,
+  // 回源加载后连同epoch一起Put, 期间有过失效则放弃写入
+  std::shared_ptr<const UserInfo> Get(int uid, uint64_t& epoch);
+  void Put(int uid, const UserInfo& info, uint64_t epoch);
+  void Invalidate(int uid);
+  void Clear();
+
+ private:
+  UserInfoCache();
+
+  std::unique_ptr<ShardedLru<std::shared_ptr<const UserInfo>>> lru_;
+  // 订阅生效期间才使用缓存
+  std::atomic<bool> subscribed_;
+};
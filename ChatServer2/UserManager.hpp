@@ -5,6 +5,10 @@
 
 class CSession;
 
+// uid到session的映射. uid是数据库自增的正整数, 用按需分配的分块稠密表保存,
+// 查找不需要哈希和遍历桶. 槽位按uid分到多个锁条带, 投递路径上只在对应条带
+// 的锁内拷贝一次shared_ptr, 不同uid之间基本不争用.
+// 超出稠密表范围的uid放进所在条带的哈希表
 class UserManager : public Singleton<UserManager> {
   friend class Singleton<UserManager>;
 
@@ -12,10 +16,33 @@ class UserManager : public Singleton<UserManager> {
   ~UserManager();
   std::shared_ptr<CSession> GetSession(int uid);
   void SetUserSession(int uid, std::shared_ptr<CSession> session);
-  void RemoveUserSession(int uid);
+  // 只有uid仍然映射到该session时才移除, 旧连接断开时不会清掉重新登录的连接.
+  // 返回是否移除
+  bool RemoveUserSession(int uid, const std::shared_ptr<CSession>& session);
 
  private:
-  UserManager() {};
-  std::mutex mtx_;
-  std::unordered_map<int, std::shared_ptr<CSession>> uid_to_session_;
-};
\ No newline at end of file
+  UserManager();
+
+  static const int kChunkBits = 12;
+  static const int kChunkSize = 1 << kChunkBits;
+  // 稠密表最多覆盖 kMaxChunks * kChunkSize 个uid
+  static const int kMaxChunks = 1 << 14;
+  static const int kStripeCount = 64;
+
+  struct Chunk {
+    std::shared_ptr<CSession> slots_[kChunkSize];
+  };
+  // 每个条带独占缓存行, 避免相邻条带的锁互相干扰
+  struct alignas(64) Stripe {
+    std::mutex mtx_;
+    std::unordered_map<int, std::shared_ptr<CSession>> overflow_;
+  };
+
+  // uid不在稠密表范围内时返回nullptr, create为false时不分配新块.
+  // 返回的槽位要在所在条带的锁内访问
+  std::shared_ptr<CSession>* FindSlot(int uid, bool create);
+  Stripe& StripeOf(int uid);
+
+  std::unique_ptr<std::atomic<Chunk*>[]> chunks_;
+  Stripe stripes_[kStripeCount];
+};
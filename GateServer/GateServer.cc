@@ -1,8 +1,21 @@
 #include "CServer.hpp"
 #include "ConfigManager.hpp"
+#include "Metrics.hpp"
 #include "utilities.hpp"
 #include "RedisManager.hpp"
 
+// 定时输出进程内计数器
+void ReportMetrics(net::steady_timer& timer, int interval) {
+  timer.expires_after(std::chrono::seconds(interval));
+  timer.async_wait([&timer, interval](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    std::cout << "[metrics] " << Metrics::GetInstance()->Dump() << std::endl;
+    ReportMetrics(timer, interval);
+  });
+}
+
 int main(int argc, char* argv[]) {
   try {
     ConfigManager& config_manager = ConfigManager::GetInstance();
@@ -16,6 +29,11 @@ int main(int argc, char* argv[]) {
       ioc.stop();
     });
     std::make_shared<CServer>(ioc, gate_port)->Start();
+    net::steady_timer metrics_timer(ioc);
+    int metrics_interval = atoi(config_manager["Metrics"]["Interval"].c_str());
+    if (metrics_interval > 0) {
+      ReportMetrics(metrics_timer, metrics_interval);
+    }
     ioc.run();
   } catch (std::exception& e) {
     std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,184 @@
+#include "JsonWriter.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+const char kHexDigits[] = "0123456789abcdef";
+
+// 控制字符, 双引号和反斜杠需要转义
+inline bool NeedEscape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// 返回第一个需要转义的字节的位置, 没有则返回len
+std::size_t FindEscape(const char* data, std::size_t len) {
+  std::size_t i = 0;
+#ifdef __SSE2__
+  // 一次比较16个字节, SSE2只有有符号比较, 先异或0x80再与0x20比较
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i limit = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+  for (; i + 16 <= len; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i mask = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                _mm_cmpeq_epi8(chunk, backslash));
+    mask = _mm_or_si128(
+        mask, _mm_cmplt_epi8(_mm_xor_si128(chunk, bias), limit));
+    int bits = _mm_movemask_epi8(mask);
+    if (bits != 0) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+#endif
+  for (; i < len; ++i) {
+    if (NeedEscape(static_cast<unsigned char>(data[i]))) {
+      return i;
+    }
+  }
+  return len;
+}
+}  // namespace
+
+void JsonWriter::Write(const Json::Value& value, std::string& out) {
+  switch (value.type()) {
+    case Json::nullValue:
+      out.append("null");
+      break;
+    case Json::intValue:
+      AppendInt(value.asLargestInt(), out);
+      break;
+    case Json::uintValue:
+      AppendUInt(value.asLargestUInt(), out);
+      break;
+    case Json::realValue:
+      AppendDouble(value.asDouble(), out);
+      break;
+    case Json::stringValue: {
+      const char* begin = nullptr;
+      const char* end = nullptr;
+      value.getString(&begin, &end);
+      AppendString(begin, end - begin, out);
+      break;
+    }
+    case Json::booleanValue:
+      out.append(value.asBool() ? "true" : "false");
+      break;
+    case Json::arrayValue: {
+      out.push_back('[');
+      Json::ArrayIndex size = value.size();
+      for (Json::ArrayIndex i = 0; i < size; ++i) {
+        if (i != 0) {
+          out.push_back(',');
+        }
+        Write(value[i], out);
+      }
+      out.push_back(']');
+      break;
+    }
+    case Json::objectValue: {
+      out.push_back('{');
+      bool first = true;
+      for (auto it = value.begin(); it != value.end(); ++it) {
+        if (!first) {
+          out.push_back(',');
+        }
+        first = false;
+        const char* key_end = nullptr;
+        const char* key = it.memberName(&key_end);
+        AppendString(key, key_end - key, out);
+        out.push_back(':');
+        Write(*it, out);
+      }
+      out.push_back('}');
+      break;
+    }
+  }
+}
+
+std::string JsonWriter::ToString(const Json::Value& value) {
+  std::string out;
+  Write(value, out);
+  return out;
+}
+
+void JsonWriter::AppendString(const char* data, std::size_t len,
+                              std::string& out) {
+  out.push_back('"');
+  while (len > 0) {
+    // 不需要转义的连续字节整段拷贝
+    std::size_t run = FindEscape(data, len);
+    out.append(data, run);
+    if (run == len) {
+      break;
+    }
+    unsigned char c = static_cast<unsigned char>(data[run]);
+    switch (c) {
+      case '"':
+        out.append("\\\"");
+        break;
+      case '\\':
+        out.append("\\\\");
+        break;
+      case '\b':
+        out.append("\\b");
+        break;
+      case '\f':
+        out.append("\\f");
+        break;
+      case '\n':
+        out.append("\\n");
+        break;
+      case '\r':
+        out.append("\\r");
+        break;
+      case '\t':
+        out.append("\\t");
+        break;
+      default: {
+        char escaped[] = {'\\', 'u', '0', '0', kHexDigits[c >> 4],
+                          kHexDigits[c & 0xf]};
+        out.append(escaped, sizeof(escaped));
+        break;
+      }
+    }
+    data += run + 1;
+    len -= run + 1;
+  }
+  out.push_back('"');
+}
+
+void JsonWriter::AppendInt(int64_t value, std::string& out) {
+  char buf[24];
+  auto result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, result.ptr - buf);
+}
+
+void JsonWriter::AppendUInt(uint64_t value, std::string& out) {
+  char buf[24];
+  auto result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, result.ptr - buf);
+}
+
+void JsonWriter::AppendDouble(double value, std::string& out) {
+  // json不能表示NaN和无穷大
+  if (!std::isfinite(value)) {
+    out.append("null");
+    return;
+  }
+  char buf[32];
+  int len = std::snprintf(buf, sizeof(buf), "%.17g", value);
+  out.append(buf, len);
+  // 与jsoncpp一致, 整数值的浮点数保留小数点
+  if (std::strpbrk(buf, ".eE") == nullptr) {
+    out.append(".0");
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "utilities.hpp"
+
+// 紧凑格式的json序列化, 不输出缩进和换行, 直接追加到调用方复用的缓冲区,
+// 替代Json::Value::toStyledString
+class JsonWriter {
+ public:
+  // 序列化结果追加到out末尾
+  static void Write(const Json::Value& value, std::string& out);
+  static std::string ToString(const Json::Value& value);
+
+  static void AppendString(const char* data, std::size_t len,
+                           std::string& out);
+  static void AppendInt(int64_t value, std::string& out);
+  static void AppendUInt(uint64_t value, std::string& out);
+  static void AppendDouble(double value, std::string& out);
+};
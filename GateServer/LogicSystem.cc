@@ -1,6 +1,7 @@
 #include "LogicSystem.hpp"
 
 #include "HttpConnection.hpp"
+#include "JsonWriter.hpp"
 #include "MysqlManager.hpp"
 #include "RedisManager.hpp"
 #include "VerifyGrpcClient.hpp"
@@ -32,6 +33,16 @@ void LogicSystem::RegisterPost(std::string url, HttpHandler handler) {
   post_handlers_[url] = handler;
 }
 
+void LogicSystem::WriteJson(const std::shared_ptr<HttpConnection>& connection,
+                            const Json::Value& root) {
+  thread_local std::string buffer;
+  buffer.clear();
+  JsonWriter::Write(root, buffer);
+  auto& body = connection->response_.body();
+  body.commit(
+      net::buffer_copy(body.prepare(buffer.size()), net::buffer(buffer)));
+}
+
 LogicSystem::LogicSystem() {
   RegisterGet("/get_test", [](std::shared_ptr<HttpConnection> connection) {
     beast::ostream(connection->response_.body())
@@ -60,16 +71,14 @@ LogicSystem::LogicSystem() {
         if (!success) {
           std::cout << "Failed to parse JSON data!" << std::endl;
           root["error"] = ErrorCodes::Error_Json;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
         if (!src_root.isMember("email")) {
           std::cout << "Failed to parse JSON data!" << std::endl;
           root["error"] = ErrorCodes::Error_Json;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
@@ -79,8 +88,7 @@ LogicSystem::LogicSystem() {
         std::cout << "email is " << email << std::endl;
         root["error"] = response.error();
         root["email"] = src_root["email"];
-        std::string jsonstr = root.toStyledString();
-        beast::ostream(connection->response_.body()) << jsonstr;
+        WriteJson(connection, root);
       });
 
   RegisterPost(
@@ -96,8 +104,7 @@ LogicSystem::LogicSystem() {
         if (!parse_success) {
           std::cout << "Failed to parse JSON data!" << std::endl;
           root["error"] = ErrorCodes::Error_Json;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
@@ -110,8 +117,7 @@ LogicSystem::LogicSystem() {
         if (pwd != confirm) {
           std::cout << "Passwords are inconsistent!" << std::endl;
           root["error"] = ErrorCodes::PasswdErr;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
@@ -122,16 +128,14 @@ LogicSystem::LogicSystem() {
         if (!get_success) {
           std::cout << "Verify code expired!" << std::endl;
           root["error"] = ErrorCodes::VerifyExpired;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
         if (verify_code != src_root["verifycode"].asString()) {
           std::cout << "Verify code error!" << std::endl;
           root["error"] = ErrorCodes::VerifyCodeErr;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
@@ -140,8 +144,7 @@ LogicSystem::LogicSystem() {
         if (0 == uid || -1 == uid) {
           std::cout << "User or email exist!" << std::endl;
           root["error"] = ErrorCodes::UserExist;
-          std::string jsonstr = root.toStyledString();
-          beast::ostream(connection->response_.body()) << jsonstr;
+          WriteJson(connection, root);
           return;
         }
 
@@ -152,8 +155,7 @@ LogicSystem::LogicSystem() {
         root["passwd"] = pwd;
         root["confirm"] = pwd;
         root["verifycode"] = verify_code;
-        std::string jsonstr = root.toStyledString();
-        beast::ostream(connection->response_.body()) << jsonstr;
+        WriteJson(connection, root);
       });
 
   RegisterPost("/reset_pwd", [](std::shared_ptr<HttpConnection> connection) {
@@ -168,8 +170,7 @@ LogicSystem::LogicSystem() {
     if (!parse_success) {
       std::cout << "Failed to parse JSON data!" << std::endl;
       root["error"] = ErrorCodes::Error_Json;
-      std::string jsonstr = root.toStyledString();
-      beast::ostream(connection->response_.body()) << jsonstr;
+      WriteJson(connection, root);
       return;
     }
 
@@ -184,8 +185,7 @@ LogicSystem::LogicSystem() {
     if (!get_success) {
       std::cout << " Verify code expired" << std::endl;
       root["error"] = ErrorCodes::VerifyExpired;
-      std::string jsonstr = root.toStyledString();
-      beast::ostream(connection->response_.body()) << jsonstr;
+      WriteJson(connection, root);
       return;
     }
 
@@ -193,8 +193,7 @@ LogicSystem::LogicSystem() {
     if (verify_code != src_root["verify_code"].asString()) {
       std::cout << "Verrify code error" << std::endl;
       root["error"] = ErrorCodes::VerifyCodeErr;
-      std::string jsonstr = root.toStyledString();
-      beast::ostream(connection->response_.body()) << jsonstr;
+      WriteJson(connection, root);
       return;
     }
 
@@ -203,8 +202,7 @@ LogicSystem::LogicSystem() {
     if (!email_valid) {
       std::cout << "Email invalid" << std::endl;
       root["error"] = ErrorCodes::EmailNotMatch;
-      std::string jsonstr = root.toStyledString();
-      beast::ostream(connection->response_.body()) << jsonstr;
+      WriteJson(connection, root);
       return;
     }
 
@@ -213,18 +211,24 @@ LogicSystem::LogicSystem() {
     if (!update_success) {
       std::cout << " update pwd failed" << std::endl;
       root["error"] = ErrorCodes::PasswdUpFailed;
-      std::string jsonstr = root.toStyledString();
-      beast::ostream(connection->response_.body()) << jsonstr;
+      WriteJson(connection, root);
       return;
     }
+    // 缓存的用户资料中包含密码, 删除redis中的旧资料, 并通知各ChatServer
+    // 删除进程内缓存
+    UserInfo user_info;
+    if (MysqlManager::GetInstance()->CheckPwd(email, pwd, user_info)) {
+      auto uid_str = std::to_string(user_info.uid);
+      RedisManager::GetInstance()->Del(kUserBaseInfo + uid_str);
+      RedisManager::GetInstance()->Publish(kUserInfoChannel, uid_str);
+    }
     std::cout << "Succeed to update password" << pwd << std::endl;
     root["error"] = 0;
     root["email"] = email;
     root["user"] = name;
     root["passwd"] = pwd;
     root["verifycode"] = src_root["verifycode"].asString();
-    std::string jsonstr = root.toStyledString();
-    beast::ostream(connection->response_.body()) << jsonstr;
+    WriteJson(connection, root);
   });
 
   //用户登录逻辑
@@ -239,8 +243,7 @@ RegisterPost("/user_login", [](std::shared_ptr<HttpConnection> connection) {
     if (!parse_success) {
         std::cout << "Failed to parse JSON data!" << std::endl;
         root["error"] = ErrorCodes::Error_Json;
-        std::string jsonstr = root.toStyledString();
-        beast::ostream(connection->response_.body()) << jsonstr;
+        WriteJson(connection, root);
         return true;
     }
 
@@ -252,8 +255,7 @@ RegisterPost("/user_login", [](std::shared_ptr<HttpConnection> connection) {
     if (!pwd_valid) {
         std::cout << "User pwd not match" << std::endl;
         root["error"] = ErrorCodes::PasswdInvalid;
-        std::string jsonstr = root.toStyledString();
-        beast::ostream(connection->response_.body()) << jsonstr;
+        WriteJson(connection, root);
         return true;
     }
 
@@ -262,8 +264,7 @@ RegisterPost("/user_login", [](std::shared_ptr<HttpConnection> connection) {
     if (reply.error()) {
         std::cout << "Grpc get chat server failed, error is " << reply.error()<< std::endl;
         root["error"] = ErrorCodes::RPCFailed;
-        std::string jsonstr = root.toStyledString();
-        beast::ostream(connection->response_.body()) << jsonstr;
+        WriteJson(connection, root);
         return true;
     }
 
@@ -273,8 +274,7 @@ RegisterPost("/user_login", [](std::shared_ptr<HttpConnection> connection) {
     root["uid"] = userInfo.uid;
     root["token"] = reply.token();
     root["host"] = reply.host();
-    std::string jsonstr = root.toStyledString();
-    beast::ostream(connection->response_.body()) << jsonstr;
+    WriteJson(connection, root);
     return true;
     });
 }
@@ -20,6 +20,10 @@ class LogicSystem : public Singleton<LogicSystem> {
 
  private:
   LogicSystem();
+  // 以紧凑格式写入响应体, 序列化缓冲区在线程内复用
+  static void WriteJson(const std::shared_ptr<HttpConnection>& connection,
+                        const Json::Value& root);
+
   std::unordered_map<std::string, HttpHandler> get_handlers_;
   std::unordered_map<std::string, HttpHandler> post_handlers_;
 };
\ No newline at end of file
@@ -59,6 +59,9 @@ enum ErrorCodes {
 };
 
 const std::string kCodePrefix = "code_";
+const std::string kUserBaseInfo = "ubaseinfo_";
+// 用户资料变化时向该频道发布uid, 各ChatServer据此删除本地缓存
+const std::string kUserInfoChannel = "userinfo_changed";
 
 class Defer {
  public:
@@ -0,0 +1,22 @@
+#include "Metrics.hpp"
+
+std::atomic<int64_t>& Metrics::Counter(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto& counter = counters_[name];
+  if (counter == nullptr) {
+    counter = std::make_unique<std::atomic<int64_t>>(0);
+  }
+  return *counter;
+}
+
+std::string Metrics::Dump() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::string out;
+  for (const auto& counter : counters_) {
+    if (!out.empty()) {
+      out += " ";
+    }
+    out += counter.first + "=" + std::to_string(counter.second->load());
+  }
+  return out;
+}
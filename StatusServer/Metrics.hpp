@@ -0,0 +1,20 @@
+#pragma once
+#include "Singleton.hpp"
+#include "utilities.hpp"
+
+// 进程内计数器, 热路径上只做原子加减, 由主线程定时输出
+class Metrics : public Singleton<Metrics> {
+  friend class Singleton<Metrics>;
+
+ public:
+  ~Metrics() {}
+  // 返回的引用在进程生命周期内有效, 调用方可以缓存为静态变量
+  std::atomic<int64_t>& Counter(const std::string& name);
+  // 以 name=value 的形式输出所有计数器
+  std::string Dump();
+
+ private:
+  Metrics() {}
+  std::mutex mtx_;
+  std::map<std::string, std::unique_ptr<std::atomic<int64_t>>> counters_;
+};
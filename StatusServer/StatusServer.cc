@@ -1,8 +1,21 @@
 #include "ConfigManager.hpp"
+#include "Metrics.hpp"
 #include "RedisManager.hpp"
 #include "StatusServerService.hpp"
 #include "utilities.hpp"
 
+// 定时输出进程内计数器
+void ReportMetrics(boost::asio::steady_timer& timer, int interval) {
+  timer.expires_after(std::chrono::seconds(interval));
+  timer.async_wait([&timer, interval](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    std::cout << "[metrics] " << Metrics::GetInstance()->Dump() << std::endl;
+    ReportMetrics(timer, interval);
+  });
+}
+
 void RunServer() {
   auto& config_manager = ConfigManager::GetInstance();
   std::string server_address(config_manager["StatusServer"]["Host"] + ":" +
@@ -27,6 +40,11 @@ void RunServer() {
       ioc.stop();
     }
   });
+  boost::asio::steady_timer metrics_timer(ioc);
+  int metrics_interval = atoi(config_manager["Metrics"]["Interval"].c_str());
+  if (metrics_interval > 0) {
+    ReportMetrics(metrics_timer, metrics_interval);
+  }
   // 在单独的线程中运行io_context
   std::thread([&]() { ioc.run(); }).detach();
   // 等待服务器关闭
@@ -19,25 +19,31 @@ void StatusServerService::InsertToken(int uid, std::string token) {
 
 ChatServer StatusServerService::LeastConnection() {
   std::lock_guard<std::mutex> lock(server_mtx_);
-  auto min_server = servers_.begin()->second;
-  int min_count;
-  std::string count_str =
-      RedisManager::GetInstance()->HGet(kLoginCount, min_server.name_);
-  if (count_str.empty()) {
-    min_count = INT_MAX;
-  } else {
-    min_count = std::atoi(count_str.c_str());
-  }
-
+  auto redis = RedisManager::GetInstance();
+  // 优先在未下线的服务器中选择, 全部在下线时退回到所有服务器中选择
+  const ChatServer* min_server = nullptr;
+  const ChatServer* min_draining = nullptr;
+  int min_count = INT_MAX;
+  int min_draining_count = INT_MAX;
   for (const auto& server : servers_) {
-    count_str =
-        RedisManager::GetInstance()->HGet(kLoginCount,server.second.name_);
-    if (count_str.empty()) continue;
-    if (std::atoi(count_str.c_str()) < min_count) {
-      min_server = server.second;
+    std::string count_str = redis->HGet(kLoginCount, server.second.name_);
+    int count = count_str.empty() ? INT_MAX : std::atoi(count_str.c_str());
+    if (!redis->HGet(kDrainingServers, server.second.name_).empty()) {
+      if (min_draining == nullptr || count < min_draining_count) {
+        min_draining = &server.second;
+        min_draining_count = count;
+      }
+      continue;
     }
+    if (min_server == nullptr || count < min_count) {
+      min_server = &server.second;
+      min_count = count;
+    }
+  }
+  if (min_server != nullptr) {
+    return *min_server;
   }
-  return min_server;
+  return min_draining != nullptr ? *min_draining : ChatServer();
 }
 
 ChatServer::ChatServer() : host_(""), port_(""), name_("") {}
@@ -67,6 +67,8 @@ const std::string kUserIpPrefix = "uip_";
 const std::string kIpCountPrefix = "ipcount_";
 const std::string kUserBaseInfo = "ubaseinfo_";
 const std::string kLoginCount = "logincount";
+// 正在下线的聊天服务器, StatusServer不再向其分配新用户
+const std::string kDrainingServers = "drainingservers";
 const std::string kNameInfo = "nameinfo_";
 
 class Defer {